@@ -0,0 +1,40 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc_counter.h"
+
+#ifdef NODE_EDITOR_COUNT_ALLOCATIONS
+
+// thread_local so that allocations done by other threads don't show up in the stats of the UI thread.
+static thread_local size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    allocations++;
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+bool heapAllocationCountingEnabled() { return true; }
+
+size_t heapAllocationCount() { return allocations; }
+
+#else
+
+bool heapAllocationCountingEnabled() { return false; }
+
+size_t heapAllocationCount() { return 0; }
+
+#endif
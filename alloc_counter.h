@@ -0,0 +1,13 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+
+// Counting heap allocations is only done when compiled with NODE_EDITOR_COUNT_ALLOCATIONS,
+// because it replaces the global operator new/delete of the whole program.
+bool heapAllocationCountingEnabled();
+
+// Number of times operator new was called by the current thread. Always 0 when counting is disabled.
+size_t heapAllocationCount();
+
+#endif
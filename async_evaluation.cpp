@@ -0,0 +1,80 @@
+#include "async_evaluation.h"
+
+AsyncEvaluator::AsyncEvaluator(std::shared_ptr<BufferPool> pool) : pool(pool), thread(&AsyncEvaluator::loop, this)
+{}
+
+AsyncEvaluator::~AsyncEvaluator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cancelRunning = true;
+        dropWaiting();
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+std::shared_future<EvaluationResult> AsyncEvaluator::evaluate(const Nodes &nodes, uint64_t version,
+                                                               std::chrono::steady_clock::time_point deadline)
+{
+    auto request = std::make_unique<Request>();
+    request->version = version;
+    request->deadline = deadline;
+    std::shared_future<EvaluationResult> future = request->promise.get_future().share();
+
+    request->evaluator = std::make_shared<GraphEvaluator>(pool);
+    request->evaluator->profiler = profiler;
+    if (!request->evaluator->compile(nodes))
+    {
+        request->promise.set_value({version, false, NULL});
+        return future;
+    }
+    if (processes) request->job = processes->serialize(nodes);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropWaiting();
+        waiting = std::move(request);
+        if (running) cancelRunning = true;
+    }
+    wake.notify_one();
+    return future;
+}
+
+void AsyncEvaluator::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    dropWaiting();
+    if (running) cancelRunning = true;
+}
+
+void AsyncEvaluator::dropWaiting()
+{
+    if (!waiting) return;
+    waiting->promise.set_value({waiting->version, false, NULL});
+    waiting = NULL;
+}
+
+void AsyncEvaluator::loop()
+{
+    while (true)
+    {
+        std::unique_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || waiting; });
+            if (stopping) return;
+            request = std::move(waiting);
+            running = true;
+            cancelRunning = false;
+        }
+        bool complete = processes
+                ? processes->evaluate(*request->evaluator, request->job, &cancelRunning, request->deadline)
+                : request->evaluator->evaluate(&cancelRunning, request->deadline);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        request->promise.set_value({request->version, complete, request->evaluator});
+    }
+}
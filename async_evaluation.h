@@ -0,0 +1,74 @@
+#ifndef ASYNC_EVALUATION_H
+#define ASYNC_EVALUATION_H
+
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "evaluation.h"
+#include "process_evaluation.h"
+
+struct EvaluationResult
+{
+    uint64_t version = 0;
+    // false if the evaluation was cancelled, superseded by a newer version, or ran past its deadline.
+    // `evaluator` then holds the outputs of the nodes that were evaluated before that (GraphEvaluator::isEvaluated()).
+    bool complete = false;
+    std::shared_ptr<GraphEvaluator> evaluator; // NULL if the graph has a loop, or the request was dropped before it started
+};
+
+/**
+ * Evaluates graphs on a background thread, always working on the newest version.
+ *
+ * Every request gets its own compiled GraphEvaluator, so the graph itself is only read on the calling thread.
+ * NodeFunctions should therefore not read node state that the UI can change (position etc.).
+ */
+class AsyncEvaluator
+{
+  public:
+    explicit AsyncEvaluator(std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>());
+    ~AsyncEvaluator();
+
+    // Compiles `nodes` on the calling thread and evaluates them on the background thread.
+    // A running evaluation is cancelled at the next node boundary, and a request that didn't start yet is dropped.
+    std::shared_future<EvaluationResult> evaluate(
+            const Nodes &nodes, uint64_t version,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()
+    );
+
+    // cancels the running evaluation and drops the waiting one.
+    void cancel();
+
+    // given to the evaluators of new requests.
+    EvaluationProfilerPtr profiler;
+
+    // if set, graphs are evaluated in worker processes instead of on the background thread. Set it before the first
+    // evaluate(). The ProcessEvaluator has to be created before this AsyncEvaluator, which starts a thread.
+    std::shared_ptr<ProcessEvaluator> processes;
+
+  private:
+    struct Request
+    {
+        uint64_t version;
+        std::shared_ptr<GraphEvaluator> evaluator;
+        ProcessEvaluator::Job job; // when evaluating with `processes`, serialized on the calling thread
+        std::chrono::steady_clock::time_point deadline;
+        std::promise<EvaluationResult> promise;
+    };
+    std::shared_ptr<BufferPool> pool;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::unique_ptr<Request> waiting;
+    bool running = false, stopping = false;
+    std::atomic<bool> cancelRunning {false};
+
+    std::thread thread;
+
+    void dropWaiting(); // mutex must be locked
+    void loop();
+};
+
+#endif
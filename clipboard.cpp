@@ -0,0 +1,202 @@
+#include <unordered_map>
+
+#include "clipboard.h"
+
+// index of c in a followed by b, or -1
+static int connectorIndex(const std::vector<NodeConnector> &a, const std::vector<NodeConnector> &b, const NodeConnector &c)
+{
+    for (int i = 0; i < a.size(); i++) if (a[i] == c) return i;
+    for (int i = 0; i < b.size(); i++) if (b[i] == c) return a.size() + i;
+    return -1;
+}
+
+// a followed by b, NULL if out of range (a type that was matched by name can have fewer connectors)
+static NodeConnector connectorAt(const std::vector<NodeConnector> &a, const std::vector<NodeConnector> &b, int i)
+{
+    if (i < 0 || i >= a.size() + b.size()) return NULL;
+    return i < a.size() ? a[i] : b[i - a.size()];
+}
+
+template <class T>
+static int indexOf(std::vector<T> &list, std::unordered_map<const void *, int> &indices, const T &item)
+{
+    auto it = indices.find(item.get());
+    if (it != indices.end()) return it->second;
+    indices[item.get()] = list.size();
+    list.push_back(item);
+    return list.size() - 1;
+}
+
+ClipboardPtr copyToClipboard(const Nodes &nodes)
+{
+    auto clipboard = std::make_shared<Clipboard>();
+    if (nodes.empty()) return clipboard;
+
+    std::unordered_map<const void *, int> typeIndices, valueTypeIndices, nodeIndices;
+    clipboard->origin = nodes[0]->position;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        nodeIndices[nodes[i].get()] = i;
+        clipboard->origin = min(clipboard->origin, nodes[i]->position);
+    }
+    clipboard->nodes.reserve(nodes.size());
+    for (auto &n : nodes)
+    {
+        Clipboard::CopiedNode c;
+        c.type = indexOf(clipboard->nodeTypes, typeIndices, n->type);
+        c.offset = n->position - clipboard->origin;
+        c.size = n->size;
+        c.collapsed = n->collapsed;
+        c.firstAdditional = clipboard->additional.size();
+        c.nrOfAdditionalInputs = n->additionalInputs.size();
+        c.nrOfAdditionalOutputs = n->additionalOutputs.size();
+        for (int i = 0; i < 2; i++) for (auto &a : i ? n->additionalOutputs : n->additionalInputs)
+            clipboard->additional.push_back({a->name, a->description, indexOf(clipboard->valueTypes, valueTypeIndices, a->valType)});
+
+        c.children = -1;
+        if (!n->children.empty())
+        {
+            c.children = clipboard->children.size();
+            clipboard->children.push_back(copyToClipboard(n->children));
+        }
+        clipboard->nodes.push_back(c);
+    }
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        const Node &n = nodes[i];
+        for (auto &conn : n->connections)
+        {
+            if (conn.srcNode != n) continue;
+            auto dst = nodeIndices.find(conn.dstNode.get());
+            if (dst == nodeIndices.end()) continue; // destination node not copied
+            int output = connectorIndex(n->type->outputs, n->additionalOutputs, conn.output);
+            int input = connectorIndex(conn.dstNode->type->inputs, conn.dstNode->additionalInputs, conn.input);
+            if (output >= 0 && input >= 0) clipboard->connections.push_back({i, output, dst->second, input});
+        }
+    }
+    return clipboard;
+}
+
+json Clipboard::toJson() const
+{
+    json j;
+    j["nodeTypes"] = json::array();
+    for (auto &t : nodeTypes) j["nodeTypes"].push_back(t->name);
+    j["valueTypes"] = json::array();
+    for (auto &t : valueTypes) j["valueTypes"].push_back(t->name);
+    j["additional"] = json::array();
+    for (auto &a : additional) j["additional"].push_back({a.name, a.description, a.valType});
+    j["nodes"] = json::array();
+    for (auto &n : nodes)
+        j["nodes"].push_back({n.type, n.offset.x, n.offset.y, n.size.x, n.size.y, n.collapsed,
+                              n.firstAdditional, n.nrOfAdditionalInputs, n.nrOfAdditionalOutputs, n.children});
+    j["connections"] = json::array();
+    for (auto &c : connections) j["connections"].push_back({c.src, c.output, c.dst, c.input});
+    j["children"] = json::array();
+    for (auto &c : children) j["children"].push_back(c->toJson());
+    j["origin"] = {origin.x, origin.y};
+    j["nrOfPastes"] = nrOfPastes;
+    return j;
+}
+
+ClipboardPtr clipboardFromJson(const json &j, const std::vector<NodeType> &nodeTypes,
+                               const std::vector<NodeValueType> &valueTypes)
+{
+    auto clipboard = std::make_shared<Clipboard>();
+    for (auto &name : j["nodeTypes"])
+    {
+        NodeType type;
+        for (auto &t : nodeTypes) if (t->name == name) type = t;
+        if (!type) return NULL;
+        clipboard->nodeTypes.push_back(type);
+    }
+    for (auto &name : j["valueTypes"])
+    {
+        NodeValueType type;
+        for (auto &t : valueTypes) if (t->name == name) type = t;
+        if (!type) return NULL;
+        clipboard->valueTypes.push_back(type);
+    }
+    for (auto &a : j["additional"]) clipboard->additional.push_back({a[0], a[1], a[2]});
+    for (auto &n : j["nodes"])
+        clipboard->nodes.push_back({n[0], vec2(n[1], n[2]), vec2(n[3], n[4]), n[5], n[6], n[7], n[8], n[9]});
+    for (auto &c : j["connections"]) clipboard->connections.push_back({c[0], c[1], c[2], c[3]});
+    for (auto &c : j["children"])
+    {
+        clipboard->children.push_back(clipboardFromJson(c, nodeTypes, valueTypes));
+        if (!clipboard->children.back()) return NULL;
+    }
+    clipboard->origin = vec2(j["origin"][0], j["origin"][1]);
+    clipboard->nrOfPastes = j["nrOfPastes"];
+    return clipboard;
+}
+
+template <class T>
+static T findType(const T &type, const std::vector<T> &types)
+{
+    for (auto &t : types) if (t == type) return t;
+    for (auto &t : types) if (t->name == type->name) return t;
+    return NULL;
+}
+
+ClipboardPaste::ClipboardPaste(ClipboardPtr clipboard, vec2 origin,
+                               const std::vector<NodeType> &nodeTypes, const std::vector<NodeValueType> &valueTypes)
+        : clipboard(clipboard), origin(origin), allNodeTypes(nodeTypes), allValueTypes(valueTypes)
+{
+    // resolve the types once, so step() only has to index:
+    for (auto &t : clipboard->nodeTypes)
+    {
+        this->nodeTypes.push_back(findType(t, nodeTypes));
+        if (!this->nodeTypes.back()) valid = false;
+    }
+    for (auto &t : clipboard->valueTypes)
+    {
+        this->valueTypes.push_back(findType(t, valueTypes));
+        if (!this->valueTypes.back()) valid = false;
+    }
+    if (valid) nodes.reserve(clipboard->nodes.size());
+}
+
+bool ClipboardPaste::step(size_t budget)
+{
+    if (!valid) return true;
+
+    // first all nodes, then the connections between them:
+    for (; nextNode < clipboard->nodes.size() && budget > 0; nextNode++, budget--)
+    {
+        const Clipboard::CopiedNode &c = clipboard->nodes[nextNode];
+
+        std::vector<NodeConnector> additionalInputs, additionalOutputs;
+        for (int i = 0; i < c.nrOfAdditionalInputs + c.nrOfAdditionalOutputs; i++)
+        {
+            const Clipboard::AdditionalConnector &a = clipboard->additional[c.firstAdditional + i];
+            (i < c.nrOfAdditionalInputs ? additionalInputs : additionalOutputs)
+                    .push_back(createNodeConnector({a.name, a.description, valueTypes[a.valType]}));
+        }
+        Nodes children;
+        if (c.children >= 0)
+        {
+            const ClipboardPtr &childClipboard = clipboard->children[c.children];
+            ClipboardPaste childPaste(childClipboard, childClipboard->origin, allNodeTypes, allValueTypes);
+            childPaste.step(-1);
+            children = childPaste.nodes;
+        }
+        nodes.push_back(createNode({
+            nodeTypes[c.type], origin + c.offset, c.size, c.collapsed, additionalInputs, additionalOutputs,
+            std::vector<Connection>(), children
+        }));
+    }
+    for (; nextNode == clipboard->nodes.size() && nextConnection < clipboard->connections.size() && budget > 0; nextConnection++, budget--)
+    {
+        const Clipboard::CopiedConnection &c = clipboard->connections[nextConnection];
+        Connection conn;
+        conn.srcNode = nodes[c.src];
+        conn.dstNode = nodes[c.dst];
+        conn.output = connectorAt(conn.srcNode->type->outputs, conn.srcNode->additionalOutputs, c.output);
+        conn.input = connectorAt(conn.dstNode->type->inputs, conn.dstNode->additionalInputs, c.input);
+        if (!conn.output || !conn.input) continue;
+        conn.srcNode->connections.push_back(conn);
+        conn.dstNode->connections.push_back(conn);
+    }
+    return isDone();
+}
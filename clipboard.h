@@ -0,0 +1,99 @@
+#ifndef CLIPBOARD_H
+#define CLIPBOARD_H
+
+#include <memory>
+#include <vector>
+
+#include "node.h"
+
+/**
+ * Copied nodes, stored so that pasting doesn't have to look anything up by name or search for connection endpoints:
+ * types are indices in `nodeTypes`/`valueTypes`, connections are indices in `nodes` and connector indices,
+ * positions are relative to `origin`.
+ */
+struct Clipboard
+{
+    std::vector<NodeType> nodeTypes; // only the ones that are used
+    std::vector<NodeValueType> valueTypes; // of the additional connectors
+
+    struct AdditionalConnector
+    {
+        std::string name, description;
+        int valType;
+    };
+    std::vector<AdditionalConnector> additional;
+
+    struct CopiedNode
+    {
+        int type;
+        vec2 offset, size; // offset from `origin`
+        bool collapsed;
+        int firstAdditional, nrOfAdditionalInputs, nrOfAdditionalOutputs; // additional inputs first, then outputs
+        int children; // index in `children`, -1 if none
+    };
+    std::vector<CopiedNode> nodes;
+
+    // connector indices: type inputs/outputs followed by additional inputs/outputs
+    struct CopiedConnection
+    {
+        int src, output, dst, input;
+    };
+    std::vector<CopiedConnection> connections;
+
+    std::vector<std::shared_ptr<Clipboard>> children;
+
+    vec2 origin; // top-left of the copied nodes
+    int nrOfPastes = 0; // every paste is placed a bit further from the original
+
+    json toJson() const;
+};
+
+typedef std::shared_ptr<Clipboard> ClipboardPtr;
+
+// Copies `nodes` and the connections between them.
+ClipboardPtr copyToClipboard(const Nodes &nodes);
+
+// NULL if a type can't be found in nodeTypes/valueTypes.
+ClipboardPtr clipboardFromJson(const json &j, const std::vector<NodeType> &nodeTypes,
+                               const std::vector<NodeValueType> &valueTypes);
+
+/**
+ * Creates the nodes and connections of a clipboard in steps, so that big pastes can be spread over several frames.
+ * The created nodes are not added to any graph, that is up to the caller when done.
+ */
+class ClipboardPaste
+{
+  public:
+    // Types are matched with nodeTypes/valueTypes (by pointer, otherwise by name), so clipboards can be pasted into
+    // other editors. isValid() is false if one of them is missing.
+    ClipboardPaste(ClipboardPtr clipboard, vec2 origin,
+                   const std::vector<NodeType> &nodeTypes, const std::vector<NodeValueType> &valueTypes);
+
+    bool isValid() const { return valid; }
+
+    // Creates at most `budget` nodes/connections. Returns true when everything is pasted.
+    bool step(size_t budget);
+
+    bool isDone() const { return nextNode == clipboard->nodes.size() && nextConnection == clipboard->connections.size(); }
+
+    size_t getNrOfNodes() const { return clipboard->nodes.size(); }
+    size_t getNrOfSteps() const { return clipboard->nodes.size() + clipboard->connections.size(); }
+    size_t getNrOfStepsDone() const { return nextNode + nextConnection; }
+
+    const ClipboardPtr &getClipboard() const { return clipboard; }
+    vec2 getOrigin() const { return origin; }
+
+    Nodes nodes; // same indices as clipboard->nodes
+
+  private:
+    ClipboardPtr clipboard;
+    vec2 origin;
+    std::vector<NodeType> nodeTypes; // same indices as clipboard->nodeTypes
+    std::vector<NodeValueType> valueTypes;
+    const std::vector<NodeType> &allNodeTypes;
+    const std::vector<NodeValueType> &allValueTypes;
+    bool valid = true;
+    size_t nextNode = 0, nextConnection = 0;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "evaluation.h"
+
+// index of c in a followed by b, or -1
+static int connectorIndex(const std::vector<NodeConnector> &a, const std::vector<NodeConnector> &b, const NodeConnector &c)
+{
+    for (int i = 0; i < a.size(); i++) if (a[i] == c) return i;
+    for (int i = 0; i < b.size(); i++) if (b[i] == c) return a.size() + i;
+    return -1;
+}
+
+GraphEvaluator::GraphEvaluator(std::shared_ptr<BufferPool> pool) : pool(pool)
+{}
+
+bool GraphEvaluator::compile(const Nodes &nodes)
+{
+    steps.clear();
+    stepOf.clear();
+    values.clear();
+    nrOfEvaluated = 0;
+
+    std::unordered_map<const Node_ *, int> index;
+    for (int i = 0; i < nodes.size(); i++) index[nodes[i].get()] = i;
+
+    // Kahn's algorithm:
+    std::vector<int> nrOfInputs(nodes.size(), 0), ready;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        for (auto &c : nodes[i]->connections)
+            if (c.dstNode == nodes[i] && index.count(c.srcNode.get())) nrOfInputs[i]++;
+        if (nrOfInputs[i] == 0) ready.push_back(i);
+    }
+    int nrOfValues = 0;
+    while (!ready.empty())
+    {
+        int i = ready.back();
+        ready.pop_back();
+        const Node &n = nodes[i];
+
+        Step step;
+        step.node = n;
+        step.inputs.assign(n->type->inputs.size() + n->additionalInputs.size(), -1);
+        step.firstOutput = nrOfValues;
+        step.nrOfOutputs = n->type->outputs.size() + n->additionalOutputs.size();
+        nrOfValues += step.nrOfOutputs;
+        stepOf[n.get()] = steps.size();
+        steps.push_back(step);
+
+        for (auto &c : n->connections)
+        {
+            if (c.srcNode != n) continue;
+            auto dst = index.find(c.dstNode.get());
+            if (dst != index.end() && --nrOfInputs[dst->second] == 0) ready.push_back(dst->second);
+        }
+    }
+    if (steps.size() != nodes.size())
+    {
+        steps.clear();
+        stepOf.clear();
+        return false; // loop
+    }
+
+    // every source is compiled now, connect the inputs to the value slots of the outputs:
+    consumers.assign(nrOfValues, 0);
+    for (auto &step : steps)
+    {
+        const Node &n = step.node;
+        for (auto &c : n->connections)
+        {
+            if (c.dstNode != n) continue;
+            auto src = stepOf.find(c.srcNode.get());
+            if (src == stepOf.end()) continue;
+            int in = connectorIndex(n->type->inputs, n->additionalInputs, c.input);
+            int out = connectorIndex(c.srcNode->type->outputs, c.srcNode->additionalOutputs, c.output);
+            if (in < 0 || out < 0) continue;
+
+            step.inputs[in] = steps[src->second].firstOutput + out;
+            consumers[step.inputs[in]]++;
+        }
+    }
+    values.resize(nrOfValues);
+    return true;
+}
+
+bool GraphEvaluator::evaluate(const std::atomic<bool> *cancel, std::chrono::steady_clock::time_point deadline)
+{
+    // release the previous values, their buffers go back to the pool and are reused below:
+    for (auto &v : values) v = Value();
+    remainingConsumers = consumers;
+    nrOfEvaluated = 0;
+    bool checkDeadline = deadline != std::chrono::steady_clock::time_point::max();
+
+    for (auto &step : steps)
+    {
+        // cancellation is checked between nodes, a running NodeFunction is never interrupted:
+        if (cancel && cancel->load(std::memory_order_relaxed)) break;
+        if (checkDeadline && std::chrono::steady_clock::now() >= deadline) break;
+
+        inputs.resize(step.inputs.size());
+        for (int i = 0; i < step.inputs.size(); i++)
+        {
+            int slot = step.inputs[i];
+            if (slot < 0) inputs[i] = Value();
+            // the last consumer takes the value, so its buffer is unique and can be modified without copying:
+            else if (!keepAllValues && --remainingConsumers[slot] == 0) inputs[i] = std::move(values[slot]);
+            else inputs[i] = values[slot]; // only a reference count increment
+        }
+        if (step.node->type->evaluate)
+        {
+            Value *outputs = values.data() + step.firstOutput;
+            int64_t start = profiler ? EvaluationProfiler::now() : 0;
+
+            step.node->type->evaluate(*step.node, inputs.data(), outputs);
+
+            if (profiler)
+            {
+                int64_t duration = EvaluationProfiler::now() - start;
+                uint64_t bytes = 0;
+                for (int i = 0; i < step.nrOfOutputs; i++) bytes += outputs[i].size();
+                profiler->record(step.node.get(), start, duration, bytes);
+            }
+        }
+        nrOfEvaluated++;
+    }
+    for (auto &v : inputs) v = Value();
+    return nrOfEvaluated == steps.size();
+}
+
+bool GraphEvaluator::setOutputs(const std::function<bool(const Node_ &node, Value *outputs, int nrOfOutputs)> &fill)
+{
+    for (auto &v : values) v = Value();
+    nrOfEvaluated = 0;
+    for (auto &step : steps)
+    {
+        if (!fill(*step.node, values.data() + step.firstOutput, step.nrOfOutputs)) break;
+        nrOfEvaluated++;
+    }
+    return nrOfEvaluated == steps.size();
+}
+
+Nodes GraphEvaluator::getNodes() const
+{
+    Nodes nodes;
+    nodes.reserve(steps.size());
+    for (auto &step : steps) nodes.push_back(step.node);
+    return nodes;
+}
+
+bool GraphEvaluator::isEvaluated(const Node_ *node) const
+{
+    auto s = stepOf.find(node);
+    return s != stepOf.end() && s->second < nrOfEvaluated;
+}
+
+const Value *GraphEvaluator::getOutput(const Node_ *node, const NodeConnector_ *output) const
+{
+    auto s = stepOf.find(node);
+    if (s == stepOf.end() || s->second >= nrOfEvaluated) return NULL;
+    const Step &step = steps[s->second];
+    int i = 0;
+    for (auto &c : node->type->outputs) if (c.get() == output) return &values[step.firstOutput + i]; else i++;
+    for (auto &c : node->additionalOutputs) if (c.get() == output) return &values[step.firstOutput + i]; else i++;
+    return NULL;
+}
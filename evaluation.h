@@ -0,0 +1,80 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "node.h"
+#include "profiler.h"
+#include "value.h"
+
+/**
+ * Evaluates a graph by calling the NodeFunction (NodeType_::evaluate) of every node in topological order.
+ *
+ * There is one Value per output connector, inputs get a reference to it. So memory grows with the number of distinct
+ * values, not with the number of connections. Buffers come from a BufferPool and are reused by the next evaluate().
+ */
+class GraphEvaluator
+{
+  public:
+    explicit GraphEvaluator(std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>());
+
+    // Sorts the nodes topologically and resolves the connections to value slots. Returns false if there is a loop.
+    // Connections to nodes that are not in `nodes` are treated as unconnected.
+    bool compile(const Nodes &nodes);
+
+    // Values of the previous evaluate() are released first, so their buffers can be reused.
+    // Stops before the next node when `cancel` becomes true or the deadline has passed.
+    // Returns true if all nodes were evaluated, otherwise the nodes evaluated so far are a partial result.
+    bool evaluate(const std::atomic<bool> *cancel = NULL,
+                  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    // Like evaluate(), but the outputs are filled in by `fill` instead of the NodeFunctions, e.g. with values computed
+    // in another process (see ProcessEvaluator). Stops at the first node for which `fill` returns false.
+    // `fill` must not read the node's connectors or connections, those might be changed by the UI thread meanwhile.
+    bool setOutputs(const std::function<bool(const Node_ &node, Value *outputs, int nrOfOutputs)> &fill);
+
+    // the compiled nodes, in topological order.
+    Nodes getNodes() const;
+
+    // Output value of the last evaluate(), NULL if the node wasn't compiled or evaluated (yet).
+    // Empty if the value was released (see keepAllValues).
+    const Value *getOutput(const Node_ *node, const NodeConnector_ *output) const;
+
+    bool isEvaluated(const Node_ *node) const;
+
+    int getNrOfEvaluated() const { return nrOfEvaluated; }
+    int getNrOfNodes() const { return steps.size(); }
+
+    // If false, a value is handed over to its last consumer instead of being kept until the next evaluate(),
+    // so that node can modify the buffer in place without copying it. getOutput() then only works for unconnected outputs.
+    bool keepAllValues = true;
+
+    BufferPool &getPool() { return *pool; }
+
+    // if set, every NodeFunction call is recorded (duration and bytes produced).
+    EvaluationProfilerPtr profiler;
+
+  private:
+    struct Step
+    {
+        Node node;
+        std::vector<int> inputs; // value slot per input, -1 if not connected
+        int firstOutput, nrOfOutputs;
+    };
+    std::vector<Step> steps;
+    std::unordered_map<const Node_ *, int> stepOf;
+    std::vector<int> consumers; // per value slot
+    int nrOfEvaluated = 0; // steps are evaluated in order, so this is also the first step that was not evaluated
+
+    std::shared_ptr<BufferPool> pool;
+    std::vector<Value> values;
+    std::vector<int> remainingConsumers;
+    std::vector<Value> inputs; // scratch
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bump allocator for scratch data that only has to live for one frame.
+ *
+ * reset() keeps the memory. If a frame needed more than one block, the blocks are merged into one big block,
+ * so after a few frames the arena stops touching the heap.
+ * Nothing allocated here gets destructed, so only use it for trivially destructible types.
+ */
+class FrameArena
+{
+  public:
+    explicit FrameArena(size_t blockSize = 16 * 1024) : blockSize(blockSize) {}
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        size_t offset = blocks.empty() ? 0 : alignedOffset(blocks.back(), align);
+        if (blocks.empty() || offset + size > blocks.back().size)
+        {
+            size_t newSize = blockSize > size + align ? blockSize : size + align;
+            blocks.push_back({std::unique_ptr<char[]>(new char[newSize]), newSize});
+            capacity += newSize;
+            used = 0;
+            offset = alignedOffset(blocks.back(), align);
+        }
+        used = offset + size;
+        bytesUsed += size;
+        return blocks.back().data.get() + offset;
+    }
+
+    template <class T>
+    T *allocArray(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena does not call destructors");
+        return static_cast<T *>(allocate(sizeof(T) * (n ? n : 1), alignof(T)));
+    }
+
+    // printf into arena memory. The returned string is valid until the next reset().
+    const char *format(const char *fmt, ...)
+    {
+        va_list args, argsCopy;
+        va_start(args, fmt);
+        va_copy(argsCopy, args);
+        int length = vsnprintf(NULL, 0, fmt, args);
+        va_end(args);
+
+        char *out = allocArray<char>(length + 1);
+        vsnprintf(out, length + 1, fmt, argsCopy);
+        va_end(argsCopy);
+        return out;
+    }
+
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            blocks.clear();
+            blocks.push_back({std::unique_ptr<char[]>(new char[capacity]), capacity});
+        }
+        used = 0;
+        bytesUsed = 0;
+    }
+
+    // bytes handed out since the last reset()
+    size_t getBytesUsed() const { return bytesUsed; }
+
+  private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+
+    // first offset >= used in block b that is aligned to `align`
+    size_t alignedOffset(const Block &b, size_t align) const
+    {
+        size_t address = reinterpret_cast<size_t>(b.data.get()) + used;
+        return used + ((align - address % align) % align);
+    }
+
+    size_t blockSize, capacity = 0, used = 0, bytesUsed = 0;
+};
+
+#endif
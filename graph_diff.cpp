@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "graph_diff.h"
+#include "node_editor.h"
+
+static uint64_t hashCombine(uint64_t h, uint64_t v)
+{
+    // splitmix64 finalizer on the value, so that combining small/similar values still spreads well:
+    v += 0x9e3779b97f4a7c15ull;
+    v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ull;
+    v = (v ^ (v >> 27)) * 0x94d049bb133111ebull;
+    v ^= v >> 31;
+    return (h ^ v) * 0x100000001b3ull;
+}
+
+static uint64_t hashString(const std::string &s)
+{
+    uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+    for (char c : s) h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+    return h;
+}
+
+uint64_t hashNodeContent(const Node &node)
+{
+    uint64_t h = hashString(node->type->name);
+    for (int i = 0; i < 2; i++)
+    {
+        auto &additional = i ? node->additionalInputs : node->additionalOutputs;
+        h = hashCombine(h, additional.size() + (i << 16));
+        for (auto &c : additional)
+            h = hashCombine(hashCombine(hashCombine(h, hashString(c->name)), hashString(c->description)), hashString(c->valType->name));
+    }
+    if (!node->children.empty()) h = hashCombine(h, hashGraph(node->children));
+    return h;
+}
+
+static uint64_t connectionHash(const Connection &c)
+{
+    return hashCombine(hashString(c.input->name), hashString(c.output->name));
+}
+
+// Merkle hashes in one direction: a node's hash covers its content and everything upstream (or downstream) of it.
+static void propagateHashes(const Nodes &nodes, const std::vector<uint64_t> &content, std::vector<uint64_t> &out, bool downstream)
+{
+    std::unordered_map<const Node_ *, int> index;
+    for (int i = 0; i < nodes.size(); i++) index[nodes[i].get()] = i;
+
+    out.assign(nodes.size(), 0);
+    // neighbour on the other side of c, if c goes in the direction that is hashed:
+    auto neighbour = [&](const Node &n, const Connection &c) -> const Node * {
+        if (downstream) return c.srcNode == n ? &c.dstNode : NULL;
+        return c.dstNode == n ? &c.srcNode : NULL;
+    };
+
+    // iterative post-order depth first search, so that long chains don't overflow the stack:
+    enum { UNVISITED, VISITING, DONE };
+    std::vector<char> state(nodes.size(), UNVISITED);
+    std::vector<int> stack;
+    std::vector<uint64_t> connected;
+    for (int root = 0; root < nodes.size(); root++)
+    {
+        if (state[root] == DONE) continue;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int i = stack.back();
+            const Node &n = nodes[i];
+            if (state[i] == UNVISITED)
+            {
+                state[i] = VISITING;
+                for (auto &c : n->connections)
+                {
+                    const Node *other = neighbour(n, c);
+                    if (!other) continue;
+                    auto o = index.find(other->get());
+                    if (o != index.end() && state[o->second] == UNVISITED) stack.push_back(o->second);
+                }
+                continue;
+            }
+            stack.pop_back();
+            if (state[i] == DONE) continue; // was pushed by more than one neighbour
+            state[i] = DONE;
+
+            connected.clear();
+            for (auto &c : n->connections)
+            {
+                const Node *other = neighbour(n, c);
+                if (!other) continue;
+                auto o = index.find(other->get());
+                // nodes outside `nodes` (or in a loop, which is still VISITING) only contribute the connector names:
+                uint64_t otherHash = o != index.end() ? out[o->second] : 0;
+                connected.push_back(hashCombine(connectionHash(c), otherHash));
+            }
+            std::sort(connected.begin(), connected.end());
+            uint64_t h = content[i];
+            for (uint64_t in : connected) h = hashCombine(h, in);
+            out[i] = h;
+        }
+    }
+}
+
+static void computeHashes(const Nodes &nodes, std::vector<uint64_t> &content, std::vector<uint64_t> &merkle)
+{
+    content.resize(nodes.size());
+    for (int i = 0; i < nodes.size(); i++) content[i] = hashNodeContent(nodes[i]);
+    propagateHashes(nodes, content, merkle, false);
+}
+
+std::vector<uint64_t> merkleHashes(const Nodes &nodes)
+{
+    std::vector<uint64_t> content, merkle;
+    computeHashes(nodes, content, merkle);
+    return merkle;
+}
+
+uint64_t hashGraph(const Nodes &nodes)
+{
+    // the merkle hashes of the sinks already cover everything upstream, sorting makes it independent of node order:
+    std::vector<uint64_t> merkle = merkleHashes(nodes);
+    std::sort(merkle.begin(), merkle.end());
+    uint64_t h = hashCombine(0, nodes.size());
+    for (uint64_t m : merkle) h = hashCombine(h, m);
+    return h;
+}
+
+static bool hasConnection(const Node &src, const std::string &output, const Node &dst, const std::string &input)
+{
+    for (auto &c : src->connections)
+        if (c.srcNode == src && c.dstNode == dst && c.output->name == output && c.input->name == input)
+            return true;
+    return false;
+}
+
+GraphPatch diffGraphs(NodeEditor &editor, const Nodes &older, const Nodes &newer)
+{
+    std::vector<uint64_t> contentA, merkleA, contentB, merkleB;
+    computeHashes(older, contentA, merkleA);
+    computeHashes(newer, contentB, merkleB);
+
+    std::unordered_map<const Node_ *, int> indexA, indexB;
+    for (int i = 0; i < older.size(); i++) indexA[older[i].get()] = i;
+    for (int j = 0; j < newer.size(); j++) indexB[newer[j].get()] = j;
+
+    std::vector<int> matchA(older.size(), -1), matchB(newer.size(), -1);
+    std::vector<std::pair<int, int>> matched; // also the queue for propagate()
+    size_t propagated = 0;
+
+    auto match = [&](int i, int j) {
+        matchA[i] = j;
+        matchB[j] = i;
+        matched.emplace_back(i, j);
+    };
+
+    // pair up unmatched nodes with equal hashes, in node order:
+    auto matchBuckets = [&](const std::vector<uint64_t> &hashesA, const std::vector<uint64_t> &hashesB) {
+        struct Bucket
+        {
+            std::vector<int> nodes;
+            size_t next = 0;
+        };
+        std::unordered_map<uint64_t, Bucket> buckets;
+        for (int j = 0; j < newer.size(); j++) if (matchB[j] < 0) buckets[hashesB[j]].nodes.push_back(j);
+        for (int i = 0; i < older.size(); i++)
+        {
+            if (matchA[i] >= 0) continue;
+            auto b = buckets.find(hashesA[i]);
+            if (b == buckets.end()) continue;
+            while (b->second.next < b->second.nodes.size() && matchB[b->second.nodes[b->second.next]] >= 0) b->second.next++;
+            if (b->second.next < b->second.nodes.size()) match(i, b->second.nodes[b->second.next++]);
+        }
+    };
+
+    // grow the matched region: neighbours that are connected through the same connectors and have the same content:
+    auto propagate = [&]() {
+        for (; propagated < matched.size(); propagated++)
+        {
+            int i = matched[propagated].first, j = matched[propagated].second;
+            const Node &a = older[i], &b = newer[j];
+            for (auto &ca : a->connections)
+            {
+                bool outgoing = ca.srcNode == a;
+                auto x = indexA.find((outgoing ? ca.dstNode : ca.srcNode).get());
+                if (x == indexA.end() || matchA[x->second] >= 0) continue;
+
+                // an output can have several consumers with the same content, prefer the one that didn't move:
+                int candidate = -1;
+                for (auto &cb : b->connections)
+                {
+                    if ((cb.srcNode == b) != outgoing || cb.input->name != ca.input->name || cb.output->name != ca.output->name)
+                        continue;
+                    auto y = indexB.find((outgoing ? cb.dstNode : cb.srcNode).get());
+                    if (y == indexB.end() || matchB[y->second] >= 0 || contentA[x->second] != contentB[y->second])
+                        continue;
+                    if (candidate < 0) candidate = y->second;
+                    if (newer[y->second]->position == older[x->second]->position)
+                    {
+                        candidate = y->second;
+                        break;
+                    }
+                }
+                if (candidate >= 0) match(x->second, candidate);
+            }
+        }
+    };
+
+    // identical nodes can only be told apart by their position, so first try to match those that didn't move:
+    auto withPosition = [](const Nodes &nodes, const std::vector<uint64_t> &hashes) {
+        std::vector<uint64_t> out(hashes.size());
+        for (int i = 0; i < nodes.size(); i++)
+        {
+            uint32_t x, y;
+            memcpy(&x, &nodes[i]->position.x, sizeof(x));
+            memcpy(&y, &nodes[i]->position.y, sizeof(y));
+            out[i] = hashCombine(hashCombine(hashes[i], x), y);
+        }
+        return out;
+    };
+    matchBuckets(withPosition(older, merkleA), withPosition(newer, merkleB));
+    matchBuckets(merkleA, merkleB);
+    propagate();
+    matchBuckets(contentA, contentB);
+    propagate();
+
+    // build the patch:
+    GraphPatch patch;
+
+    std::vector<GraphPatch::NodeRef> refs = nodeRefs(older);
+
+    for (int i = 0; i < older.size(); i++) if (matchA[i] < 0) patch.removedNodes.push_back(refs[i]);
+
+    Nodes added;
+    std::vector<int> addedIndex(newer.size(), -1);
+    for (int j = 0; j < newer.size(); j++)
+    {
+        if (matchB[j] >= 0) continue;
+        addedIndex[j] = added.size();
+        added.push_back(newer[j]);
+    }
+    if (!added.empty()) patch.addedNodes = editor.toJson(added);
+
+    for (auto &m : matched)
+    {
+        const Node &a = older[m.first], &b = newer[m.second];
+        if (a->position != b->position || a->size != b->size || a->collapsed != b->collapsed)
+            patch.layoutChanges.push_back({refs[m.first], b->position, b->size, b->collapsed});
+    }
+
+    // connections between matched nodes that are gone (connections of removed nodes are removed with the node):
+    for (int i = 0; i < older.size(); i++)
+    {
+        if (matchA[i] < 0) continue;
+        for (auto &c : older[i]->connections)
+        {
+            if (c.srcNode != older[i]) continue;
+            auto x = indexA.find(c.dstNode.get());
+            if (x == indexA.end() || matchA[x->second] < 0) continue;
+            if (!hasConnection(newer[matchA[i]], c.output->name, newer[matchA[x->second]], c.input->name))
+            {
+                GraphPatch::ConnectionChange change;
+                change.src.existing = refs[i];
+                change.dst.existing = refs[x->second];
+                change.output = c.output->name;
+                change.input = c.input->name;
+                patch.removedConnections.push_back(change);
+            }
+        }
+    }
+    // new connections (connections between two added nodes are already in addedNodes):
+    for (int j = 0; j < newer.size(); j++)
+    {
+        for (auto &c : newer[j]->connections)
+        {
+            if (c.srcNode != newer[j]) continue;
+            auto y = indexB.find(c.dstNode.get());
+            if (y == indexB.end()) continue;
+            int srcI = matchB[j], dstI = matchB[y->second];
+            if (srcI < 0 && dstI < 0) continue;
+            if (srcI >= 0 && dstI >= 0 && hasConnection(older[srcI], c.output->name, older[dstI], c.input->name))
+                continue;
+
+            GraphPatch::ConnectionChange change;
+            if (srcI >= 0) change.src.existing = refs[srcI];
+            else change.src.added = addedIndex[j];
+            if (dstI >= 0) change.dst.existing = refs[dstI];
+            else change.dst.added = addedIndex[y->second];
+            change.output = c.output->name;
+            change.input = c.input->name;
+            patch.addedConnections.push_back(change);
+        }
+    }
+    return patch;
+}
+
+std::vector<GraphPatch::NodeRef> nodeRefs(const Nodes &nodes)
+{
+    std::vector<uint64_t> content, upstream, downstream;
+    computeHashes(nodes, content, upstream);
+    propagateHashes(nodes, content, downstream, true);
+
+    std::vector<GraphPatch::NodeRef> refs(nodes.size());
+    for (int i = 0; i < nodes.size(); i++) refs[i] = {upstream[i], downstream[i], nodes[i]->position};
+    return refs;
+}
+
+static uint64_t hashRef(const GraphPatch::NodeRef &ref)
+{
+    uint32_t x, y;
+    memcpy(&x, &ref.position.x, sizeof(x));
+    memcpy(&y, &ref.position.y, sizeof(y));
+    return hashCombine(hashCombine(hashCombine(ref.upstream, ref.downstream), x), y);
+}
+
+std::vector<Node> resolveNodeRefs(const Nodes &nodes, const std::vector<GraphPatch::NodeRef> &refs)
+{
+    std::vector<GraphPatch::NodeRef> nodesRefs = nodeRefs(nodes);
+    std::unordered_multimap<uint64_t, int> byRef;
+    for (int i = 0; i < nodes.size(); i++) byRef.emplace(hashRef(nodesRefs[i]), i);
+
+    std::vector<Node> resolved(refs.size());
+    for (int r = 0; r < refs.size(); r++)
+    {
+        const GraphPatch::NodeRef &ref = refs[r];
+        auto range = byRef.equal_range(hashRef(ref));
+        int matches = 0;
+        for (auto it = range.first; it != range.second; it++)
+        {
+            const GraphPatch::NodeRef &candidate = nodesRefs[it->second];
+            if (candidate.upstream != ref.upstream || candidate.downstream != ref.downstream || candidate.position != ref.position)
+                continue;
+            if (matches++ == 0) resolved[r] = nodes[it->second];
+        }
+        if (matches > 1) resolved[r] = NULL; // ambiguous, picking one could change the wrong node
+    }
+    return resolved;
+}
@@ -0,0 +1,91 @@
+#ifndef GRAPH_DIFF_H
+#define GRAPH_DIFF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "node.h"
+
+class NodeEditor;
+
+/**
+ * Hashes that don't depend on the order of nodes or on the ids given by toJson():
+ *
+ * - content hash: type, additional connectors and children (recursively). Not the position/size/collapsed state,
+ *   so moving a node doesn't change it.
+ * - merkle hash: content hash + the sorted incoming connections (input name, output name, merkle hash of the source).
+ *   Two nodes have the same merkle hash if everything upstream of them is identical.
+ */
+uint64_t hashNodeContent(const Node &node);
+
+// merkle hash of every node, same indices as `nodes`. Assumes the graph has no loops.
+std::vector<uint64_t> merkleHashes(const Nodes &nodes);
+
+// hash of a whole (sub)graph, independent of the order of `nodes`.
+uint64_t hashGraph(const Nodes &nodes);
+
+/**
+ * Changes that turn one version of a graph into another, see diffGraphs().
+ */
+struct GraphPatch
+{
+    // A node in the graph that the patch was made against, identified independently of the order of the nodes:
+    // its merkle hash (upstream), the same kind of hash over everything downstream of it, and its position.
+    // Nodes that have all three in common can't be told apart, references to them are rejected by resolveNodeRefs().
+    struct NodeRef
+    {
+        uint64_t upstream, downstream;
+        vec2 position;
+    };
+
+    // A node that is either already in the graph, or added by the patch.
+    struct PatchNode
+    {
+        int added = -1; // index in addedNodes, or -1 if `existing` is used.
+        NodeRef existing;
+    };
+
+    struct LayoutChange
+    {
+        NodeRef node;
+        vec2 position, size;
+        bool collapsed;
+    };
+
+    struct ConnectionChange
+    {
+        PatchNode src, dst;
+        std::string output, input;
+    };
+
+    std::vector<NodeRef> removedNodes;
+    json addedNodes; // NodeEditor::toJson() format, only includes the connections between added nodes.
+    std::vector<LayoutChange> layoutChanges;
+    std::vector<ConnectionChange> removedConnections, addedConnections;
+
+    bool empty() const
+    {
+        return removedNodes.empty() && addedNodes.empty() && layoutChanges.empty()
+               && removedConnections.empty() && addedConnections.empty();
+    }
+};
+
+/**
+ * Matches the nodes of `older` and `newer`:
+ * 1. nodes with equal merkle hashes (identical upstream), in one pass over hash buckets. Nodes that also have the same
+ *    position are matched first.
+ * 2. from matched pairs, neighbours connected through the same connectors that have equal content hashes.
+ * 3. remaining nodes with equal content hashes.
+ * Then returns the patch that turns `older` into `newer`. Apply it with NodeEditor::applyPatch().
+ * `editor` is used to serialize the added nodes.
+ */
+GraphPatch diffGraphs(NodeEditor &editor, const Nodes &older, const Nodes &newer);
+
+// references to every node, same indices as `nodes`.
+std::vector<GraphPatch::NodeRef> nodeRefs(const Nodes &nodes);
+
+// Finds the nodes referenced by a patch. Returns NULL for references that are not in `nodes`, or that match more than one.
+std::vector<Node> resolveNodeRefs(const Nodes &nodes, const std::vector<GraphPatch::NodeRef> &refs);
+
+#endif
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include "input_recording.h"
+
+InputRecorder::InputRecorder(NodeEditor &editor)
+{
+    recording["nodes"] = editor.toJson(editor.nodes);
+    // so that pasting without copying first replays the same:
+    if (NodeEditor::clipboard) recording["clipboard"] = NodeEditor::clipboard->toJson();
+    recording["frames"] = json::array();
+
+    // the view and the options that change what is under the mouse:
+    json &view = recording["view"];
+    view["scroll"] = {editor.scroll.x, editor.scroll.y};
+    view["zoom"] = editor.zoom;
+    view["zoomSpeed"] = editor.zoomSpeed;
+    view["showMinimap"] = editor.showMinimap;
+    view["minimapSize"] = {editor.minimapSize.x, editor.minimapSize.y};
+    view["showProfile"] = editor.showProfile;
+    view["pasteStepsPerFrame"] = editor.pasteStepsPerFrame;
+}
+
+void InputRecorder::recordFrame()
+{
+    ImGuiIO &io = ImGui::GetIO();
+    json frame;
+    frame["dt"] = io.DeltaTime;
+    frame["mouse"] = {io.MousePos.x, io.MousePos.y};
+    frame["wheel"] = io.MouseWheel;
+    int buttons = 0;
+    for (int i = 0; i < IM_ARRAYSIZE(io.MouseDown); i++) if (io.MouseDown[i]) buttons |= 1 << i;
+    frame["buttons"] = buttons;
+
+    json keys = json::array();
+    for (int i = 0; i < IM_ARRAYSIZE(io.KeysDown); i++) if (io.KeysDown[i]) keys.push_back(i);
+    frame["keys"] = keys;
+    frame["mods"] = (io.KeyCtrl ? 1 : 0) | (io.KeyShift ? 2 : 0) | (io.KeyAlt ? 4 : 0) | (io.KeySuper ? 8 : 0);
+
+    json chars = json::array();
+    for (ImWchar c : io.InputQueueCharacters) chars.push_back(c);
+    frame["chars"] = chars;
+
+    vec2 windowPos = ImGui::GetWindowPos(), windowSize = ImGui::GetWindowSize();
+    frame["window"] = {windowPos.x, windowPos.y, windowSize.x, windowSize.y};
+    frame["focused"] = ImGui::IsWindowFocused();
+
+    recording["frames"].push_back(frame);
+}
+
+bool InputRecorder::save(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file) return false;
+    file << recording;
+    return bool(file);
+}
+
+uint64_t graphChecksum(const Nodes &nodes)
+{
+    std::vector<uint64_t> merkle = merkleHashes(nodes), perNode(nodes.size());
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        float layout[5] = {nodes[i]->position.x, nodes[i]->position.y, nodes[i]->size.x, nodes[i]->size.y, float(nodes[i]->collapsed)};
+        uint64_t h = merkle[i] ^ 0xcbf29ce484222325ull; // FNV-1a over the layout
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(layout);
+        for (int b = 0; b < sizeof(layout); b++) h = (h ^ bytes[b]) * 0x100000001b3ull;
+        perNode[i] = h;
+    }
+    std::sort(perNode.begin(), perNode.end()); // independent of the order of nodes, which changes when clicking on nodes.
+    uint64_t h = hashGraph(nodes);
+    for (uint64_t p : perNode) h = (h ^ p) * 0x100000001b3ull;
+    return h;
+}
+
+ReplayResult replayRecording(const std::string &path, const std::vector<NodeType> &nodeTypes,
+                             const std::vector<NodeValueType> &valueTypes)
+{
+    ReplayResult result;
+    std::ifstream file(path);
+    if (!file) return result;
+    json recording = json::parse(file, NULL, false);
+    if (recording.is_discarded()) return result;
+
+    // CreateContext() only makes the new context current if there is none, don't drive the host's context:
+    ImGuiContext *hostContext = ImGui::GetCurrentContext();
+    ImGuiContext *context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+    auto restoreContext = [&]() {
+        ImGui::DestroyContext(context);
+        ImGui::SetCurrentContext(hostContext);
+    };
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.DisplaySize = ImVec2(1920, 1080);
+    // NewFrame() needs a font atlas, but nothing is ever uploaded:
+    unsigned char *pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    // load the graph with a separate editor, so that the first history entry of the replayed editor is the initial graph:
+    Nodes initialNodes = NodeEditor(Nodes(), nodeTypes, valueTypes).fromJson(recording["nodes"], result.success);
+    if (!result.success)
+    {
+        restoreContext();
+        return result;
+    }
+    NodeEditor editor(initialNodes, nodeTypes, valueTypes);
+    if (recording.contains("view"))
+    {
+        json &view = recording["view"];
+        editor.scroll = vec2(view["scroll"][0], view["scroll"][1]);
+        editor.zoom = view["zoom"];
+        editor.zoomSpeed = view["zoomSpeed"];
+        editor.showMinimap = view["showMinimap"];
+        editor.minimapSize = vec2(view["minimapSize"][0], view["minimapSize"][1]);
+        editor.showProfile = view["showProfile"];
+        editor.pasteStepsPerFrame = view["pasteStepsPerFrame"];
+    }
+    ClipboardPtr clipboardBefore = NodeEditor::clipboard;
+    NodeEditor::clipboard = recording.contains("clipboard")
+            ? clipboardFromJson(recording["clipboard"], nodeTypes, valueTypes) : NULL;
+
+    for (json &frame : recording["frames"])
+    {
+        io.DeltaTime = max(frame["dt"].get<float>(), 1e-5f); // ImGui asserts on a delta time of 0
+        io.MousePos = vec2(frame["mouse"][0], frame["mouse"][1]);
+        io.MouseWheel = frame["wheel"];
+        int buttons = frame["buttons"];
+        for (int i = 0; i < IM_ARRAYSIZE(io.MouseDown); i++) io.MouseDown[i] = buttons & (1 << i);
+
+        memset(io.KeysDown, 0, sizeof(io.KeysDown));
+        for (int key : frame["keys"]) if (key >= 0 && key < IM_ARRAYSIZE(io.KeysDown)) io.KeysDown[key] = true;
+        int mods = frame["mods"];
+        io.KeyCtrl = mods & 1;
+        io.KeyShift = mods & 2;
+        io.KeyAlt = mods & 4;
+        io.KeySuper = mods & 8;
+        for (unsigned c : frame["chars"]) io.AddInputCharacter(c);
+
+        auto start = std::chrono::steady_clock::now();
+        ImGui::NewFrame();
+
+        json &window = frame["window"];
+        ImGui::SetNextWindowPos(vec2(window[0], window[1]));
+        ImGui::SetNextWindowSize(vec2(window[2], window[3]));
+        if (frame["focused"]) ImGui::SetNextWindowFocus();
+        ImGui::Begin("node editor replay", NULL, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings);
+        editor.draw(ImGui::GetWindowDrawList());
+        ImGui::End();
+
+        ImGui::Render(); // builds the draw lists, there is no backend that renders them.
+        result.frameTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    result.checksum = graphChecksum(editor.nodes);
+
+    NodeEditor::clipboard = clipboardBefore;
+    restoreContext();
+    return result;
+}
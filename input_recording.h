@@ -0,0 +1,46 @@
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+#include <string>
+#include <vector>
+
+#include "node_editor.h"
+
+/**
+ * Records everything that drives NodeEditor::draw() (the initial graph, scroll, zoom and view options, mouse, keys,
+ * window position/size), so that a session can be replayed headless with replayRecording().
+ *
+ * Usage: create it before the first frame, call recordFrame() every frame right before editor.draw()
+ * (inside the window that the editor is drawn in), and save() when done.
+ */
+class InputRecorder
+{
+  public:
+    explicit InputRecorder(NodeEditor &editor);
+
+    void recordFrame();
+
+    bool save(const std::string &path) const;
+
+  private:
+    json recording;
+};
+
+struct ReplayResult
+{
+    bool success = false; // false if the file could not be read or the initial graph could not be loaded
+    std::vector<double> frameTimes; // seconds per frame, for NewFrame() until Render()
+    uint64_t checksum = 0; // of the graph after the last frame, see graphChecksum()
+};
+
+/**
+ * Replays a recording in a new ImGui context without a renderer backend, so it can run on a machine without a display.
+ * The NodeEditor is created with the given types, which should be the same as the ones used while recording.
+ */
+ReplayResult replayRecording(const std::string &path, const std::vector<NodeType> &nodeTypes,
+                             const std::vector<NodeValueType> &valueTypes);
+
+// hashGraph() combined with the layout (position, size, collapsed) of every node.
+uint64_t graphChecksum(const Nodes &nodes);
+
+#endif
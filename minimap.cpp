@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+
+#include "minimap.h"
+
+// color of a node on the minimap: the type of its first output, or first input for nodes without outputs.
+static const NodeValueType_ *nodeValueType(const Node &node)
+{
+    if (!node->type->outputs.empty()) return node->type->outputs[0]->valType.get();
+    if (!node->additionalOutputs.empty()) return node->additionalOutputs[0]->valType.get();
+    if (!node->type->inputs.empty()) return node->type->inputs[0]->valType.get();
+    return NULL;
+}
+
+static vec2 nodeSize(const Node_ *node)
+{
+    return node->collapsed ? vec2(node->size.x, 30) : node->size;
+}
+
+uint64_t Minimap::tileOf(vec2 canvasPos) const
+{
+    int x = int(std::floor(canvasPos.x / tileSize)), y = int(std::floor(canvasPos.y / tileSize));
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+void Minimap::removeNode(const Node_ *node, uint64_t tileKey)
+{
+    auto tile = tiles.find(tileKey);
+    if (tile == tiles.end()) return;
+    auto &n = tile->second.nodes;
+    auto it = std::find(n.begin(), n.end(), node);
+    if (it != n.end()) n.erase(it);
+    if (n.empty()) tiles.erase(tile);
+    else tile->second.dirty = true;
+    boundsDirty = true;
+}
+
+void Minimap::updateNode(const Node &node)
+{
+    vec2 size = nodeSize(node.get());
+    uint64_t tile = tileOf(node->position + size * .5f);
+    const NodeValueType_ *valType = nodeValueType(node);
+
+    auto it = entries.find(node.get());
+    if (it != entries.end())
+    {
+        Entry &e = it->second;
+        e.syncGeneration = syncGeneration;
+        if (e.position == node->position && e.size == node->size && e.collapsed == node->collapsed && e.valType == valType)
+            return; // nothing changed
+        if (e.tile != tile)
+        {
+            removeNode(node.get(), e.tile);
+            tiles[tile].nodes.push_back(node.get());
+        }
+        e = {tile, node->position, node->size, node->collapsed, valType, syncGeneration};
+    }
+    else
+    {
+        entries[node.get()] = {tile, node->position, node->size, node->collapsed, valType, syncGeneration};
+        tiles[tile].nodes.push_back(node.get());
+    }
+    tiles[tile].dirty = true;
+    boundsDirty = true;
+}
+
+void Minimap::sync(const Nodes &nodes)
+{
+    syncGeneration++;
+    for (auto &n : nodes) updateNode(n);
+    // nodes that were not seen are removed:
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->second.syncGeneration == syncGeneration)
+        {
+            ++it;
+            continue;
+        }
+        removeNode(it->first, it->second.tile);
+        it = entries.erase(it);
+    }
+}
+
+void Minimap::update(const Node &node)
+{
+    updateNode(node);
+}
+
+void Minimap::remove(const Node_ *node)
+{
+    auto it = entries.find(node);
+    if (it == entries.end()) return;
+    removeNode(node, it->second.tile);
+    entries.erase(it);
+}
+
+void Minimap::recomputeTile(Tile &tile)
+{
+    tile.count = tile.nodes.size();
+    tile.min = vec2(INFINITY);
+    tile.max = vec2(-INFINITY);
+
+    // most common value type. A tile only has a few different ones, a linear search is faster than a map:
+    votes.clear();
+    const NodeValueType_ *dominant = NULL;
+    int mostVotes = 0;
+    for (const Node_ *n : tile.nodes)
+    {
+        const Entry &e = entries[n];
+        tile.min = min(tile.min, e.position);
+        tile.max = max(tile.max, e.position + nodeSize(n));
+        if (!e.valType) continue;
+        auto vote = std::find_if(votes.begin(), votes.end(), [&](const std::pair<const NodeValueType_ *, int> &v) { return v.first == e.valType; });
+        if (vote == votes.end()) vote = votes.insert(votes.end(), {e.valType, 0});
+        if (++vote->second > mostVotes)
+        {
+            mostVotes = vote->second;
+            dominant = e.valType;
+        }
+    }
+    tile.color = dominant ? dominant->color : vec3(.6);
+    tile.dirty = false;
+}
+
+bool Minimap::draw(ImDrawList *drawList, const ImRect &area, vec2 viewMin, vec2 viewMax, bool interact, vec2 &lookAt)
+{
+    if (boundsDirty)
+    {
+        boundsMin = vec2(INFINITY);
+        boundsMax = vec2(-INFINITY);
+    }
+    for (auto &t : tiles)
+    {
+        if (t.second.dirty) recomputeTile(t.second);
+        if (!boundsDirty) continue;
+        boundsMin = min(boundsMin, t.second.min);
+        boundsMax = max(boundsMax, t.second.max);
+    }
+    boundsDirty = false;
+
+    if (!interact || !mappingFrozen)
+    {
+        // show the view too, also when it is outside the graph:
+        worldMin = tiles.empty() ? viewMin : min(boundsMin, viewMin);
+        vec2 worldMax = tiles.empty() ? viewMax : max(boundsMax, viewMax);
+        vec2 worldSize = max(worldMax - worldMin, vec2(1));
+        vec2 areaMin = area.Min, areaSize = vec2(area.Max) - areaMin;
+        scale = min(areaSize.x / worldSize.x, areaSize.y / worldSize.y);
+        offset = areaMin + (areaSize - worldSize * scale) * .5f; // centered
+    }
+    mappingFrozen = interact;
+
+    drawList->AddRectFilled(area.Min, area.Max, ImColor(.1f, .1, .12, .8), 4);
+    drawList->PushClipRect(area.Min, area.Max, true); // the frozen mapping can put the view outside the area
+    for (auto &t : tiles)
+    {
+        const Tile &tile = t.second;
+        // more nodes -> more opaque:
+        float alpha = min(1.f, .35f + .05f * tile.count);
+        drawList->AddRectFilled(
+                offset + (tile.min - worldMin) * scale,
+                offset + max(tile.max - worldMin, tile.min - worldMin + vec2(2 / scale)) * scale,
+                ImColor(vec4(tile.color, alpha))
+        );
+    }
+    drawList->AddRect(offset + (viewMin - worldMin) * scale, offset + (viewMax - worldMin) * scale, ImColor(1.f, 1., 1., .8), 0, ImDrawCornerFlags_All, 1.5);
+    drawList->PopClipRect();
+    drawList->AddRect(area.Min, area.Max, ImColor(.4f, .4, .4), 4);
+
+    if (!interact) return false;
+    lookAt = worldMin + (vec2(ImGui::GetMousePos()) - offset) / scale;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "node.h"
+
+/**
+ * Overview of the whole graph, drawn from a coarse grid of tile summaries instead of from the nodes themselves.
+ *
+ * Every tile knows how many nodes have their center in it, the bounding box of those nodes and the most common
+ * value type color. Tiles are only recomputed when one of their nodes moved, changed or was removed,
+ * and drawing costs O(tiles).
+ */
+class Minimap
+{
+  public:
+    float tileSize = 500; // in canvas units
+
+    // Checks every node, and finds removed ones. Only needed when the whole graph was replaced, single edits should
+    // use update() and remove().
+    void sync(const Nodes &nodes);
+
+    // Adds a node, or moves it to its new tile if it moved/resized/collapsed. Only the affected tiles are recomputed.
+    void update(const Node &node);
+
+    void remove(const Node_ *node);
+
+    size_t getNrOfNodes() const { return entries.size(); }
+
+    // Draws the tiles and the view rectangle in `area`. Returns true and sets `lookAt` (canvas space) when the
+    // minimap is clicked/dragged. While `interact` stays true the mapping from canvas to minimap stays the same,
+    // so the view doesn't run away from the mouse when the bounds grow/shrink because of the drag.
+    bool draw(ImDrawList *drawList, const ImRect &area, vec2 viewMin, vec2 viewMax, bool interact, vec2 &lookAt);
+
+  private:
+    struct Entry
+    {
+        uint64_t tile;
+        vec2 position, size;
+        bool collapsed;
+        const NodeValueType_ *valType;
+        unsigned syncGeneration;
+    };
+    std::unordered_map<const Node_ *, Entry> entries;
+
+    struct Tile
+    {
+        std::vector<const Node_ *> nodes;
+        int count = 0;
+        vec2 min, max; // bounding box of the nodes
+        vec3 color;
+        bool dirty = true;
+    };
+    std::unordered_map<uint64_t, Tile> tiles;
+    unsigned syncGeneration = 0;
+    vec2 boundsMin, boundsMax; // of all tiles
+    bool boundsDirty = true;
+
+    // canvas -> minimap: offset + (p - worldMin) * scale
+    vec2 worldMin, offset;
+    float scale = 1;
+    bool mappingFrozen = false;
+
+    std::vector<std::pair<const NodeValueType_ *, int>> votes; // scratch for recomputeTile()
+
+    uint64_t tileOf(vec2 canvasPos) const;
+    void updateNode(const Node &node);
+    void removeNode(const Node_ *node, uint64_t tile);
+    void recomputeTile(Tile &tile);
+};
+
+#endif
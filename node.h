@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 
 #include "imgui_includes.h"
 
@@ -29,6 +30,13 @@ typedef std::shared_ptr<NodeConnector_> NodeConnector;
 static NodeConnector createNodeConnector(NodeConnector_ x) { return std::make_shared<NodeConnector_>(x); }
 
 
+class Node_;
+struct Value;
+
+// Computes the outputs of a node, see GraphEvaluator.
+// inputs and outputs are in the order: type inputs/outputs, then additional inputs/outputs. Unconnected inputs are empty.
+typedef std::function<void(const Node_ &node, Value *inputs, Value *outputs)> NodeFunction;
+
 struct NodeType_
 {
     std::string name, description;
@@ -36,6 +44,8 @@ struct NodeType_
     std::vector<NodeConnector> inputs, outputs;
 
     bool canHaveChildren;
+
+    NodeFunction evaluate; // optional
 };
 typedef std::shared_ptr<NodeType_> NodeType;
 
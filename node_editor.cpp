@@ -1,29 +1,47 @@
 #include <iostream>
+#include <cmath>
 #include <algorithm>
+#include <unordered_set>
 #include <GLFW/glfw3.h>
 
 #include "node_editor.h"
+#include "alloc_counter.h"
 
 int nodeEditorI = 0;
-json NodeEditor::copiedNodes = json();
+ClipboardPtr NodeEditor::clipboard;
 
 NodeEditor::NodeEditor(Nodes nodes, std::vector<NodeType> nodeTypes, std::vector<NodeValueType> valueTypes)
     :
     nodes(nodes), nodeTypes(nodeTypes), valueTypes(valueTypes),
-    id("node_editor_" + (nodeEditorI++)), addMenuId((id + "_add_menu").c_str())
+    id("node_editor_" + std::to_string(nodeEditorI++)), addMenuId(id + "_add_menu")
 {
     createHistory();
 }
 
 void NodeEditor::deleteNode(Node node)
+{
+    deleteNodes({node});
+}
+
+void NodeEditor::deleteNodes(Nodes toDelete)
 {
     activeNode = NULL; // todo kfhskfgjhfdkgjh
-    nodes.erase(
-        std::remove_if(
-            nodes.begin(), nodes.end(), [node](Node &n) { return n == node; }
-        ), nodes.end()
-    );
-    while (!node->connections.empty()) deleteConnection(node->connections.back());
+    std::unordered_set<const Node_ *> deleted;
+    for (auto &node : toDelete)
+    {
+        deleted.insert(node.get());
+        while (!node->connections.empty()) deleteConnection(node->connections.back());
+        minimap.remove(node.get());
+        if (previews)
+        {
+            for (auto &c : node->type->outputs) previews->forget(node.get(), c.get());
+            for (auto &c : node->additionalOutputs) previews->forget(node.get(), c.get());
+        }
+    }
+    // one pass over `nodes` and `selectedNodes` for all deleted nodes:
+    auto isDeleted = [&](const Node &n) { return deleted.count(n.get()) > 0; };
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(), isDeleted), nodes.end());
+    selectedNodes.erase(std::remove_if(selectedNodes.begin(), selectedNodes.end(), isDeleted), selectedNodes.end());
 }
 
 // Try to find in the Haystack the Needle - ignore case
@@ -65,14 +83,17 @@ void NodeEditor::drawBackground(ImDrawList *drawList)
         drawList->AddLine(vec2(pos.x, y), vec2(pos.x + windowSize.x, y), color, max(1.f, zoom));
 }
 
-bool NodeEditor::isSelected(Node node)
+bool NodeEditor::isSelected(const Node &node)
 {
-    for (Node n : selectedNodes) if (n == node) return true;
+    for (const Node &n : selectedNodes) if (n == node) return true;
     return false;
 }
 
 void NodeEditor::draw(ImDrawList *drawList)
 {
+    size_t allocationsBefore = heapAllocationCount();
+    frameArena.reset();
+
     multiSelect = ImGui::IsKeyDown(GLFW_KEY_LEFT_SHIFT) || ImGui::IsKeyDown(GLFW_KEY_LEFT_CONTROL);
     updateZoom();
     pos = ImGui::GetWindowPos();
@@ -85,40 +106,77 @@ void NodeEditor::draw(ImDrawList *drawList)
 
     drawPos = pos / zoom + scroll;
 
+    // clicks on the minimap should not fall through to the nodes:
+    mouseOverMinimap = showMinimap && getMinimapRectangle().Contains(ImGui::GetMousePos());
+    if (mouseOverMinimap && hasFocus && ImGui::IsMouseClicked(0)) draggingMinimap = true;
+    if (!ImGui::IsMouseDown(0)) draggingMinimap = false;
+
     if (shortcutPressed(GLFW_KEY_LEFT_CONTROL, GLFW_KEY_Z)) undo();
     if (shortcutPressed(GLFW_KEY_LEFT_CONTROL, GLFW_KEY_Y)) redo();
 
     drawBackground(drawList);
     drawAddMenu();
+    prepareFrame();
+    if (previews) previews->deliverPending();
+    if (showProfile && profiler) profile.collect(*profiler);
     drawConnections(drawList);
     hoveringNode = NULL;
     hoveringNodeI = -1;
     // updateNode() will set hoveringNode if needed:
     for (int i = 0; i < nodes.size(); i++) updateNode(i);
     // draw the nodes:
-    for (auto node : nodes) drawNode(node, drawList);
+    for (int i = 0; i < nodes.size(); i++) drawNode(nodes[i], nodeGeometry[i], drawList);
 
     updateSelection(drawList);
+    if (pasting) updatePaste();
 
     hasFocus = ImGui::IsWindowFocused();
     prevMousePos = mousePos;
 
+    if (creatingConnection) updateCreatingConnection(drawList);
     if (creatingConnection && !ImGui::IsMouseDown(0)) creatingConnection = NULL;
-    if (creatingConnection)
-    {
-        vec2 originPos = connectorPosition(creatingConnection->srcNode, creatingConnection->output);
-        vec2 dstPos = (mousePos - scroll + drawPos) * zoom;
-
-        float xDiff = abs(originPos.x - dstPos.x) * .6;
-        drawList->AddBezierCurve(originPos, originPos + vec2(xDiff, 0), dstPos - vec2(xDiff, 0), dstPos, ImColor(vec4(1)), zoom * 3);
-    }
 
     if (ImGui::IsKeyPressed(GLFW_KEY_DELETE))
     {
         if (selectedNodes.empty() && activeNode) deleteNode(activeNode);
-        else for (auto &n : selectedNodes) deleteNode(n);
+        else deleteNodes(selectedNodes);
         createHistory();
     }
+
+    if (showMinimap) updateMinimap(drawList);
+    else minimapSynced = false; // drags are not tracked while hidden
+
+    trackChanges();
+
+    lastFrameStats.heapAllocations = heapAllocationCountingEnabled() ? int(heapAllocationCount() - allocationsBefore) : -1;
+    lastFrameStats.arenaBytes = frameArena.getBytesUsed();
+}
+
+ImRect NodeEditor::getMinimapRectangle()
+{
+    vec2 windowSize = ImGui::GetWindowSize();
+    return ImRect(pos + windowSize - minimapSize - vec2(10), pos + windowSize - vec2(10));
+}
+
+void NodeEditor::updateMinimap(ImDrawList *drawList)
+{
+    // edits update the minimap where they happen, only check everything when the nodes were replaced, or were
+    // added/removed by someone else:
+    if (!minimapSynced || minimap.getNrOfNodes() != nodes.size())
+    {
+        minimap.sync(nodes);
+        minimapSynced = true;
+    }
+    else if (currentlyDragging && isSelected(currentlyDragging))
+        for (auto &n : selectedNodes) minimap.update(n);
+    else if (currentlyDragging) minimap.update(currentlyDragging);
+    if (currentlyResizing) minimap.update(currentlyResizing);
+
+    // the part of the canvas that is in view:
+    vec2 viewMin = -scroll, viewMax = viewMin + vec2(ImGui::GetWindowSize()) / zoom;
+    vec2 lookAt;
+    if (minimap.draw(drawList, getMinimapRectangle(), viewMin, viewMax, draggingMinimap, lookAt))
+        scroll = -(lookAt - (viewMax - viewMin) * .5f);
 }
 
 void NodeEditor::updateSelection(ImDrawList *drawList)
@@ -138,32 +196,17 @@ void NodeEditor::updateSelection(ImDrawList *drawList)
         } else if (!isSelected(activeNode)) selectedNodes.clear();
 
     } // clear selection if user clicks on background:
-    else if (ImGui::IsMouseDown(0) && !currentlyDragging && !currentlyResizing && !multiSelect) selectedNodes.clear();
+    else if (ImGui::IsMouseDown(0) && !currentlyDragging && !currentlyResizing && !multiSelect && !draggingMinimap) selectedNodes.clear();
 
-    if (shortcutPressed(GLFW_KEY_C, GLFW_KEY_LEFT_CONTROL) && hasFocus)
-    {
-        NodeEditor::copiedNodes = toJson(isSelected(activeNode) ? selectedNodes : Nodes{activeNode});
-        std::cout << NodeEditor::copiedNodes << "\n";
-    }
-    if (shortcutPressed(GLFW_KEY_V, GLFW_KEY_LEFT_CONTROL) && hasFocus)
-    {
-        bool success;
-        Nodes pasted = fromJson(copiedNodes, success);
-        for (Node n : pasted)
-        {
-            n->position += vec2(100, 100);
-            nodes.push_back(n);
-        }
-        if (!success) std::cout << "parsing nodes unsuccessful\n";
-        selectedNodes = pasted;
-        copiedNodes = toJson(pasted); // hack to give the next paste extra offset.
-        createHistory();
-    }
+    if (shortcutPressed(GLFW_KEY_C, GLFW_KEY_LEFT_CONTROL) && hasFocus && activeNode)
+        clipboard = copyToClipboard(isSelected(activeNode) ? selectedNodes : Nodes{activeNode});
+    if (shortcutPressed(GLFW_KEY_V, GLFW_KEY_LEFT_CONTROL) && hasFocus && clipboard && !pasting)
+        paste();
     if (shortcutPressed(GLFW_KEY_A, GLFW_KEY_LEFT_CONTROL) && hasFocus)
         selectedNodes = nodes;
 
     selecting = false;
-    if (creatingConnection || currentlyDragging || currentlyResizing || dragDelta.x + dragDelta.y == 0 || !ImGui::IsMouseDown(0)) return;
+    if (creatingConnection || currentlyDragging || currentlyResizing || draggingMinimap || dragDelta.x + dragDelta.y == 0 || !ImGui::IsMouseDown(0)) return;
     selecting = true;
 
     // get the selection rectangle:
@@ -177,7 +220,7 @@ void NodeEditor::updateSelection(ImDrawList *drawList)
     selectRect.Max.y = max(temp.Max.y, temp.Min.y);
     if (!multiSelect) selectedNodes.clear();
     // look for nodes in selection rectangle:
-    for (auto n : nodes) if (getNodeRectangle(n).Overlaps(selectRect) && !isSelected(n)) selectedNodes.push_back(n);
+    for (const auto &n : nodes) if (getNodeRectangle(n).Overlaps(selectRect) && !isSelected(n)) selectedNodes.push_back(n);
 
     // draw selection rectangle:
     drawList->AddRectFilled(selectRect.Min, selectRect.Max, ImColor(.1f, 1., 1., .5));
@@ -186,10 +229,11 @@ void NodeEditor::updateSelection(ImDrawList *drawList)
 
 void NodeEditor::updateNode(int i)
 {
-    Node node = nodes[i];
-    ImRect nodeRect = getNodeRectangle(node);
+    const Node &node = nodes[i];
+    const ImRect &nodeRect = nodeGeometry[i].rect; // computed by prepareFrame()
     if (
             hasFocus
+            && !mouseOverMinimap && !draggingMinimap
             && nodeRect.Contains(ImGui::GetMousePos())
             && (!currentlyDragging || currentlyDragging == node)
             && (!currentlyResizing || currentlyResizing == node)
@@ -200,14 +244,17 @@ void NodeEditor::updateNode(int i)
     }
 }
 
-void NodeEditor::drawNode(Node node, ImDrawList *drawList)
+void NodeEditor::drawNode(const Node &node, const NodeGeometry &geometry, ImDrawList *drawList)
 {
+    // nodes out of view can still be interacted with when the mouse leaves the window while dragging/resizing:
+    if (!geometry.visible && node != currentlyDragging && node != currentlyResizing) return;
+
     bool hovering = hoveringNode == node;
     bool active = activeNode == node;
     bool selected = isSelected(node);
     int rounding = (node->collapsed ? 15 : 4) * zoom;
     int roundingFlags = ImDrawCornerFlags_Top | ImDrawCornerFlags_BotLeft | (node->collapsed ? ImDrawCornerFlags_BotRight : 0);
-    ImRect nodeRect = getNodeRectangle(node);
+    const ImRect &nodeRect = geometry.rect;
     // draw shadow using a hack:
     for (int i = 0; i < 8; i++)
         drawList->AddRectFilled(
@@ -217,13 +264,24 @@ void NodeEditor::drawNode(Node node, ImDrawList *drawList)
     // node background:
     drawList->AddRectFilled(nodeRect.Min, nodeRect.Max, ImColor(.3f, .3, .35, .85), rounding, roundingFlags);
 
+    // profile heatmap:
+    const ProfileSummary::NodeStats *stats = showProfile ? profile.get(node.get()) : NULL;
+    if (stats && profile.getTotalNs() > 0)
+    {
+        float share = float(stats->totalNs) / profile.getTotalNs();
+        drawList->AddRectFilled(nodeRect.Min, nodeRect.Max, ImColor(1.f, .3, .1, share * .8), rounding, roundingFlags);
+        if (zoom >= .5)
+            drawList->AddText(NULL, 11 * zoom, vec2(nodeRect.Min.x, nodeRect.Max.y) + vec2(4, 6) * zoom, ImColor(1.f, 1., 1., .7),
+                              frameArena.format("%.2f ms x %d (%.0f%%)", stats->totalNs / 1e6 / stats->calls, stats->calls, share * 100));
+    }
+
     resizeNode(node, drawList);
     // node outline:
     drawList->AddRect(nodeRect.Min, nodeRect.Max,
                       active || selected ? ImColor(.4f, .2, 1.) :
                       (hovering ? ImColor(.4f, .1, .6) : ImColor(.4f, .4, .4)),
                       rounding, roundingFlags, 2);
-    drawNodeConnectors(node, drawList);
+    drawNodeConnectors(node, geometry, drawList);
     dragNode(node, drawList, rounding);
 
 
@@ -245,7 +303,7 @@ void NodeEditor::drawNode(Node node, ImDrawList *drawList)
         );
 }
 
-void NodeEditor::resizeNode(Node node, ImDrawList *drawList)
+void NodeEditor::resizeNode(const Node &node, ImDrawList *drawList)
 {
     if (node->collapsed) return;
     ImRect nodeRect = getNodeRectangle(node);
@@ -280,7 +338,7 @@ void NodeEditor::resizeNode(Node node, ImDrawList *drawList)
         }
     }
 }
-void NodeEditor::dragNode(Node node, ImDrawList *drawList, float dragBarRounding)
+void NodeEditor::dragNode(const Node &node, ImDrawList *drawList, float dragBarRounding)
 {
     // drag bar:
     ImRect nodeRect = getNodeRectangle(node);
@@ -299,7 +357,7 @@ void NodeEditor::dragNode(Node node, ImDrawList *drawList, float dragBarRounding
         {
             currentlyDragging = node;
             if (isSelected(node)) // move each selected node:
-                for (auto n : selectedNodes) n->position += mousePos - prevMousePos;
+                for (const auto &n : selectedNodes) n->position += mousePos - prevMousePos;
             else
             { // if user is dragging a non-selected node, then clear the selection:
                 selectedNodes.clear();
@@ -315,81 +373,113 @@ void NodeEditor::dragNode(Node node, ImDrawList *drawList, float dragBarRounding
             // collapse node if collapse-icon was clicked:
             ImRect collapseRect = ImRect(nodeRect.Min + vec2(8 * zoom), nodeRect.Min + vec2(24 * zoom));
             if (dragDelta.x + dragDelta.y == 0 && ImGui::IsMouseReleased(0) && !multiSelect && collapseRect.Contains(ImGui::GetMousePos()))
+            {
                 node->collapsed = !node->collapsed;
+                minimap.update(node);
+            }
         }
     }
 }
 
-void NodeEditor::drawNodeConnectors(Node node, ImDrawList *drawList)
+void NodeEditor::drawNodeConnectors(const Node &node, const NodeGeometry &geometry, ImDrawList *drawList)
 {
-    for (const auto& c : node->type->inputs) drawNodeConnector(node, c, drawList);
-    for (const auto& c : node->type->outputs) drawNodeConnector(node, c, drawList);
-    for (const auto& c : node->additionalInputs) drawNodeConnector(node, c, drawList);
-    for (const auto& c : node->additionalOutputs) drawNodeConnector(node, c, drawList);
+    const vec2 *pos = geometry.connectorPositions;
+    for (const auto& c : node->type->inputs) drawNodeConnector(node, c, *pos++, drawList);
+    for (const auto& c : node->type->outputs)
+    {
+        drawOutputPreview(node, c, *pos, drawList);
+        drawNodeConnector(node, c, *pos++, drawList);
+    }
+    for (const auto& c : node->additionalInputs) drawNodeConnector(node, c, *pos++, drawList);
+    for (const auto& c : node->additionalOutputs)
+    {
+        drawOutputPreview(node, c, *pos, drawList);
+        drawNodeConnector(node, c, *pos++, drawList);
+    }
 }
 
-void NodeEditor::drawNodeConnector(Node node, NodeConnector c, ImDrawList *drawList)
+void NodeEditor::drawOutputPreview(const Node &node, const NodeConnector &c, vec2 pos, ImDrawList *drawList)
 {
-    vec2 pos = connectorPosition(node, c);
+    ConnectorPreview preview;
+    if (!previews || zoom < .5 || !previews->read(node.get(), c.get(), preview)) return;
+
+    vec2 min = pos + vec2(10, -8) * zoom, max = min + vec2(40, 16) * zoom;
+    if (preview.nrOfSamples < 2)
+    {
+        drawList->AddText(NULL, 11 * zoom, min, ImColor(1.f, 1., 1., .7), preview.text);
+        return;
+    }
+    // small graph of the samples:
+    float low = preview.samples[0], high = preview.samples[0];
+    for (int i = 1; i < preview.nrOfSamples; i++)
+    {
+        low = glm::min(low, preview.samples[i]);
+        high = glm::max(high, preview.samples[i]);
+    }
+    float range = high - low > 0 ? high - low : 1;
+    ImVec2 points[IM_ARRAYSIZE(preview.samples)];
+    for (int i = 0; i < preview.nrOfSamples; i++)
+        points[i] = vec2(
+            min.x + (max.x - min.x) * i / (preview.nrOfSamples - 1),
+            max.y - (max.y - min.y) * (preview.samples[i] - low) / range
+        );
+    drawList->AddRectFilled(min, max, ImColor(0.f, 0., 0., .5), 2 * zoom);
+    drawList->AddPolyline(points, preview.nrOfSamples, ImColor(c->valType->color), false, zoom);
+}
+
+static bool valueTypesMatch(const NodeConnector &output, const NodeConnector &input)
+{
+    const NodeValueType &outType = output->valType, &inType = input->valType;
+    return inType == outType || inType->any || outType->any || inType->name == outType->name;
+}
 
+void NodeEditor::drawNodeConnector(const Node &node, const NodeConnector &c, vec2 pos, ImDrawList *drawList)
+{
     drawList->AddCircleFilled(pos, 6 * zoom, ImColor(c->valType->color));
     drawList->AddCircle(pos, 6 * zoom, ImColor((c->valType->color * vec3(.5))), 12, zoom);
 
     // show type of connector when hovering:
     bool hoveringConnector = hasFocus && length(vec2(ImGui::GetMousePos()) - pos) < 15 * zoom;
 
-    bool draggingConnector = hasFocus && dragDelta.x + dragDelta.y != 0 && !currentlyDragging && !currentlyResizing
+    bool draggingConnector = hasFocus && dragDelta.x + dragDelta.y != 0 && !currentlyDragging && !currentlyResizing && !draggingMinimap
                                 && length(vec2(ImGui::GetMousePos() - dragDelta) - pos) < 15 * zoom;
 
     if (hoveringConnector) ImGui::SetTooltip("%s", c->valType->name.c_str());
 
+    // explain why an input is not a target for the connection being created:
+    if (hoveringConnector && creatingConnection && isInput(node, c))
+    {
+        const NodeConnector &output = creatingConnection->output;
+        if (!valueTypesMatch(output, c))
+            ImGui::SetTooltip("Invalid value type (%s -> %s)", output->valType->name.c_str(), c->valType->name.c_str());
+        else if (connectionUpstream.count(node.get())) ImGui::SetTooltip("Creates infinite loop");
+        else if (isConnected(node, c)) ImGui::SetTooltip("Input is already connected");
+    }
+
     if (hoveringConnector || draggingConnector)
     {
         bool connIsInput = isInput(node, c); // is this connector on the left side of the node?
-        if (creatingConnection && hoveringConnector)
-        {
-            Connection connection = *creatingConnection;
-            connection.dstNode = node;
-            connection.input = c;
-            if (connIsInput && !isConnected(node, c))
-            {
-                connection.srcNode->connections.push_back(connection);
-                node->connections.push_back(connection);
-                bool createsLoop = containsLoop();
-                bool typesMatch = c->valType->any || connection.output->valType->any || connection.output->valType->name == c->valType->name;
-                if (createsLoop || !ImGui::IsMouseReleased(0) || !typesMatch)
-                {
-                    if (!typesMatch) ImGui::SetTooltip("Invalid value type (%s -> %s)", connection.output->valType->name.c_str(), c->valType->name.c_str());
-                    if (createsLoop) ImGui::SetTooltip("Creates infinite loop");
-
-                    connection.srcNode->connections.pop_back();
-                    node->connections.pop_back();
-                }
-                else
-                {
-                    creatingConnection = NULL;
-                    createHistory();
-                }
-            }
-        }
-        else if (draggingConnector)
+        // (connecting to an input while creatingConnection is handled by updateCreatingConnection())
+        if (draggingConnector && !creatingConnection)
         {
             if (!connIsInput)
-                creatingConnection = std::make_unique<Connection>(Connection{
+                startConnection(Connection{
                         node, NULL,
                         c, NULL
                 });
             else if (isConnected(node, c))
             {
-                for (auto &connection : getInputConnections(node))
+                for (auto &existing : node->connections)
                 {
-                    if (connection.input != c) continue;
+                    if (existing.dstNode != node || existing.input != c) continue;
                     // pulling existing connection out of input connector:
+                    Connection connection = existing; // copy, deleteConnection() removes `existing`.
                     deleteConnection(connection);
-                    creatingConnection = std::make_unique<Connection>(connection);
-                    creatingConnection->input = NULL;
-                    creatingConnection->dstNode = NULL;
+                    connection.input = NULL;
+                    connection.dstNode = NULL;
+                    startConnection(connection);
                     createHistory();
+                    break; // an input can only have one connection
                 }
             }
         }
@@ -399,6 +489,122 @@ void NodeEditor::drawNodeConnector(Node node, NodeConnector c, ImDrawList *drawL
     drawList->AddText(NULL, 13 * zoom, pos, ImColor(vec4(1)), c->name.c_str());
 }
 
+static const float CONNECTION_TARGET_CELL_SIZE = 64;
+
+static uint64_t connectionTargetCell(int x, int y)
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+const char *NodeEditor::connectionProblem(const Connection &c)
+{
+    if (!isInput(c.dstNode, c.input) || isInput(c.srcNode, c.output)) return "Not an output to an input";
+    if (!valueTypesMatch(c.output, c.input)) return "Invalid value type";
+    if (isConnected(c.dstNode, c.input)) return "Input is already connected";
+
+    // the destination must not be upstream of the source:
+    std::unordered_set<const Node_ *> upstream = {c.srcNode.get()};
+    Nodes toVisit = {c.srcNode};
+    while (!toVisit.empty())
+    {
+        Node n = toVisit.back();
+        toVisit.pop_back();
+        if (n == c.dstNode) return "Creates infinite loop";
+        for (auto &conn : n->connections)
+            if (conn.dstNode == n && upstream.insert(conn.srcNode.get()).second)
+                toVisit.push_back(conn.srcNode);
+    }
+    return NULL;
+}
+
+void NodeEditor::startConnection(const Connection &partial)
+{
+    creatingConnection = std::make_unique<Connection>(partial);
+    connectionTargets.clear();
+    connectionTargetGrid.clear();
+    snapTarget = -1;
+
+    // nodes upstream of the source (including the source itself) would create a loop:
+    std::unordered_set<const Node_ *> &upstream = connectionUpstream;
+    upstream = {partial.srcNode.get()};
+    Nodes toVisit = {partial.srcNode};
+    while (!toVisit.empty())
+    {
+        Node n = toVisit.back();
+        toVisit.pop_back();
+        for (auto &c : n->connections)
+            if (c.dstNode == n && upstream.insert(c.srcNode.get()).second)
+                toVisit.push_back(c.srcNode);
+    }
+
+    // the type check is done once here, instead of for every hovered connector every frame:
+    auto addTargets = [&](const Node &n, const std::vector<NodeConnector> &inputs) {
+        for (auto &input : inputs)
+        {
+            if (!valueTypesMatch(partial.output, input) || isConnected(n, input)) continue;
+
+            vec2 canvasPos = connectorPosition(n, input) / zoom - drawPos;
+            ivec2 cell = ivec2(floor(canvasPos / CONNECTION_TARGET_CELL_SIZE));
+            connectionTargetGrid[connectionTargetCell(cell.x, cell.y)].push_back(connectionTargets.size());
+            connectionTargets.push_back({n, input, canvasPos});
+        }
+    };
+    for (auto &n : nodes)
+    {
+        if (upstream.count(n.get())) continue;
+        addTargets(n, n->type->inputs);
+        addTargets(n, n->additionalInputs);
+    }
+}
+
+void NodeEditor::updateCreatingConnection(ImDrawList *drawList)
+{
+    // snap to the nearest target within the snap radius:
+    float snapRadius = 40 / zoom; // 40 pixels, in canvas space
+    vec2 mouseCanvas = mousePos - scroll;
+    ivec2 minCell = ivec2(floor((mouseCanvas - vec2(snapRadius)) / CONNECTION_TARGET_CELL_SIZE)),
+          maxCell = ivec2(floor((mouseCanvas + vec2(snapRadius)) / CONNECTION_TARGET_CELL_SIZE));
+    snapTarget = -1;
+    float nearest = snapRadius;
+    for (int x = minCell.x; x <= maxCell.x; x++) for (int y = minCell.y; y <= maxCell.y; y++)
+    {
+        auto cell = connectionTargetGrid.find(connectionTargetCell(x, y));
+        if (cell == connectionTargetGrid.end()) continue;
+        for (int i : cell->second)
+        {
+            float dist = length(connectionTargets[i].canvasPos - mouseCanvas);
+            if (dist >= nearest) continue;
+            nearest = dist;
+            snapTarget = i;
+        }
+    }
+
+    // highlight every target in view:
+    ImRect view(pos, pos + vec2(ImGui::GetWindowSize()));
+    for (int i = 0; i < connectionTargets.size(); i++)
+    {
+        vec2 screenPos = (connectionTargets[i].canvasPos + drawPos) * zoom;
+        if (!view.Contains(screenPos)) continue;
+        drawList->AddCircle(screenPos, (i == snapTarget ? 12 : 9) * zoom, ImColor(.4f, 1., .6, i == snapTarget ? 1. : .6), 16, 2 * zoom);
+    }
+
+    vec2 originPos = connectorPosition(creatingConnection->srcNode, creatingConnection->output);
+    vec2 dstPos = snapTarget >= 0 ? (connectionTargets[snapTarget].canvasPos + drawPos) * zoom : (mousePos - scroll + drawPos) * zoom;
+
+    float xDiff = abs(originPos.x - dstPos.x) * .6;
+    drawList->AddBezierCurve(originPos, originPos + vec2(xDiff, 0), dstPos - vec2(xDiff, 0), dstPos, ImColor(vec4(1)), zoom * 3);
+
+    if (snapTarget < 0 || !ImGui::IsMouseReleased(0)) return;
+
+    Connection connection = *creatingConnection;
+    connection.dstNode = connectionTargets[snapTarget].node;
+    connection.input = connectionTargets[snapTarget].input;
+    connection.srcNode->connections.push_back(connection);
+    connection.dstNode->connections.push_back(connection);
+    creatingConnection = NULL;
+    createHistory();
+}
+
 std::vector<Connection> NodeEditor::getOutputConnections(Node n)
 {
     std::vector<Connection> c;
@@ -412,7 +618,7 @@ std::vector<Connection> NodeEditor::getInputConnections(Node n) {
     return c;
 }
 
-vec2 NodeEditor::connectorPosition(Node node, NodeConnector conn)
+vec2 NodeEditor::connectorPosition(const Node &node, const NodeConnector &conn)
 {
     bool input = isInput(node, conn);
     ImRect nodeRect = getNodeRectangle(node);
@@ -423,19 +629,19 @@ vec2 NodeEditor::connectorPosition(Node node, NodeConnector conn)
     int row = 0;
     if (input)
     {
-        for (NodeConnector c : node->type->inputs)
+        for (const NodeConnector &c : node->type->inputs)
             if (c == conn) break;
             else row++;
-        for (NodeConnector c : node->additionalInputs)
+        for (const NodeConnector &c : node->additionalInputs)
             if (c == conn) break;
             else row++;
     }
     else
     {
-        for (NodeConnector c : node->type->outputs)
+        for (const NodeConnector &c : node->type->outputs)
             if (c == conn) break;
             else row++;
-        for (NodeConnector c : node->additionalOutputs)
+        for (const NodeConnector &c : node->additionalOutputs)
             if (c == conn) break;
             else row++;
     }
@@ -443,14 +649,14 @@ vec2 NodeEditor::connectorPosition(Node node, NodeConnector conn)
     return pos;
 }
 
-bool NodeEditor::isInput(Node node, NodeConnector conn)
+bool NodeEditor::isInput(const Node &node, const NodeConnector &conn)
 {
-    for (NodeConnector c : node->type->inputs) if (c == conn) return true;
-    for (NodeConnector c : node->additionalInputs) if (c == conn) return true;
+    for (const NodeConnector &c : node->type->inputs) if (c == conn) return true;
+    for (const NodeConnector &c : node->additionalInputs) if (c == conn) return true;
     return false;
 }
 
-ImRect NodeEditor::getNodeRectangle(Node node)
+ImRect NodeEditor::getNodeRectangle(const Node &node)
 {
     ImRect rect(drawPos.x + node->position.x, drawPos.y + node->position.y,
                 drawPos.x + node->position.x + node->size.x, drawPos.y + node->position.y + node->size.y);
@@ -465,9 +671,9 @@ ImRect NodeEditor::getNodeRectangle(Node node)
 void NodeEditor::drawAddMenu()
 {
     if (hasFocus && ImGui::IsKeyPressed(GLFW_KEY_A) && ImGui::IsKeyDown(GLFW_KEY_LEFT_SHIFT))
-        ImGui::OpenPopup(addMenuId);
+        ImGui::OpenPopup(addMenuId.c_str());
 
-    if (ImGui::BeginPopupContextWindow(addMenuId))
+    if (ImGui::BeginPopupContextWindow(addMenuId.c_str()))
     {
         for (auto c : ImGui::GetIO().InputQueueCharacters)
             if (filter.length() > 0 || c != 'A')
@@ -479,25 +685,26 @@ void NodeEditor::drawAddMenu()
             if (ImGui::IsKeyPressed(GLFW_KEY_BACKSPACE))
                 filter.pop_back();
 
-            ImGui::Text("%s", ("Filter: " + filter).c_str());
+            ImGui::Text("Filter: %s", filter.c_str());
         } else ImGui::Text("Add node");
         ImGui::Separator();
         addMenuSelectedI += ImGui::IsKeyPressed(GLFW_KEY_DOWN) ? 1 : (ImGui::IsKeyPressed(GLFW_KEY_UP) ? -1 : 0);
 
         int i = 0;
-        for (auto nodeType : nodeTypes)
+        for (const auto &nodeType : nodeTypes)
         {
             if (!findStringIC(nodeType->name, filter))
                 continue;
             bool selected = addMenuSelectedI == i;
 
-            std::string name = selected ? ">" + nodeType->name + "<" : nodeType->name;
-            if (ImGui::MenuItem(name.c_str(), NULL, selected) || (selected && ImGui::IsKeyPressed(GLFW_KEY_ENTER)))
+            const char *name = selected ? frameArena.format(">%s<", nodeType->name.c_str()) : nodeType->name.c_str();
+            if (ImGui::MenuItem(name, NULL, selected) || (selected && ImGui::IsKeyPressed(GLFW_KEY_ENTER)))
             {
                 Node n = createNode({ nodeType });
                 n->position = addPos;
                 n->size = vec2(100, 100);
                 nodes.push_back(n);
+                minimap.update(n);
                 activeNode = n;
                 selectedNodes.clear();
                 createHistory();
@@ -522,28 +729,154 @@ void NodeEditor::drawAddMenu()
     }
 }
 
-bool NodeEditor::isConnected(Node n, NodeConnector c)
+bool NodeEditor::isConnected(const Node &n, const NodeConnector &c)
 {
-    for (auto &connection : getInputConnections(n))
-        if (connection.input == c) return true;
-    for (auto &connection : getOutputConnections(n))
-        if (connection.output == c) return true;
+    for (auto &connection : n->connections)
+        if ((connection.dstNode == n && connection.input == c) || (connection.srcNode == n && connection.output == c))
+            return true;
     return false;
 }
 
 void NodeEditor::drawConnections(ImDrawList *drawList)
 {
-    for (auto &n : nodes)
+    // the curves were tessellated by prepareFrame():
+    for (size_t i = 0; i < nrOfEdges; i++)
     {
-        ImColor outlineColor = n == activeNode ? ImColor(.4f, .2, 1.) : ImColor(vec4(vec3(.3), 1));
-        for (auto &c : getInputConnections(n))
+        const EdgeGeometry &e = edgeGeometry[i];
+        if (!e.nrOfPoints) continue;
+        ImColor outlineColor = e.connection->dstNode == activeNode ? ImColor(.4f, .2, 1.) : ImColor(vec4(vec3(.3), 1));
+        drawList->AddPolyline(e.points, e.nrOfPoints, outlineColor, false, zoom * 4);
+        drawList->AddPolyline(e.points, e.nrOfPoints, ImColor(vec4(1)), false, zoom * 2.5);
+
+        // value flowing through the connection, only the latest published one:
+        ConnectorPreview preview;
+        if (previews && zoom >= .5 && previews->read(e.connection->srcNode.get(), e.connection->output.get(), preview))
+            drawList->AddText(NULL, 11 * zoom, e.points[e.nrOfPoints / 2] + vec2(4, -14) * zoom, ImColor(1.f, 1., 1., .8), preview.text);
+
+        // data volume, per evaluation of the source node:
+        const ProfileSummary::NodeStats *stats = showProfile && zoom >= .5 ? profile.get(e.connection->srcNode.get()) : NULL;
+        if (stats)
         {
-            vec2 p0 = connectorPosition(n, c.input), p1 = connectorPosition(c.srcNode, c.output);
+            double bytes = double(stats->bytesProduced) / stats->calls;
+            const char *label = bytes >= 1 << 20 ? frameArena.format("%.1f MB", bytes / (1 << 20))
+                              : bytes >= 1 << 10 ? frameArena.format("%.1f KB", bytes / (1 << 10))
+                              : frameArena.format("%.0f B", bytes);
+            drawList->AddText(NULL, 11 * zoom, e.points[e.nrOfPoints / 2] + vec2(4, 2) * zoom, ImColor(1.f, .6, .3, .9), label);
+        }
+    }
+}
+
+static const int MAX_CONNECTION_SEGMENTS = 256;
+
+// Level of detail: about one segment per 6 pixels of the curve on screen, so long connections stay smooth when zoomed in.
+// The length of the control polygon is an upper bound of the curve's length.
+static int connectionSegments(vec2 p0, vec2 p1)
+{
+    float xDiff = abs(p0.x - p1.x) * .6;
+    int segments = int((length(p1 - p0) + 2 * xDiff) / 6);
+    return segments < 4 ? 4 : (segments > MAX_CONNECTION_SEGMENTS ? MAX_CONNECTION_SEGMENTS : segments);
+}
+
+// Writes segments + 1 points on the curve between an input connector at p0 and an output connector at p1 to `out`.
+static void tessellateConnection(vec2 p0, vec2 p1, int segments, ImVec2 *out)
+{
+    float xDiff = abs(p0.x - p1.x) * .6;
+    vec2 p0b = p0 - vec2(xDiff, 0), p1b = p1 + vec2(xDiff, 0);
+
+    for (int i = 0; i <= segments; i++)
+    {
+        float t = float(i) / segments, u = 1 - t;
+        out[i] = p0 * (u * u * u) + p0b * (3 * u * u * t) + p1b * (3 * u * t * t) + p1 * (t * t * t);
+    }
+}
+
+void NodeEditor::prepareFrame()
+{
+    ImRect view(pos, pos + vec2(ImGui::GetWindowSize()));
+    // connectors (and the area in which they can be hovered) stick out of the node rectangle:
+    float margin = 20 * zoom;
+    ImRect cullRect(view.Min - vec2(margin), view.Max + vec2(margin));
+
+    // allocate everything up front, the workers can't use the frame arena:
+    nodeGeometry = frameArena.allocArray<NodeGeometry>(nodes.size());
+    nrOfEdges = 0;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        const Node &n = nodes[i];
+        size_t nrOfConnectors = n->type->inputs.size() + n->type->outputs.size()
+                                + n->additionalInputs.size() + n->additionalOutputs.size();
+        nodeGeometry[i].connectorPositions = frameArena.allocArray<vec2>(nrOfConnectors);
+        for (auto &c : n->connections) if (c.dstNode == n) nrOfEdges++;
+    }
+    edgeGeometry = frameArena.allocArray<EdgeGeometry>(nrOfEdges);
+    size_t e = 0;
+    for (auto &n : nodes) for (auto &c : n->connections)
+    {
+        if (c.dstNode != n) continue;
+        edgeGeometry[e].connection = &c;
+        edgeGeometry[e++].points = NULL; // allocated once the number of points is known, see below
+    }
+
+    // the workers only read the graph and write to their own elements of nodeGeometry/edgeGeometry:
+    auto prepareNodes = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            const Node &n = nodes[i];
+            NodeGeometry &g = nodeGeometry[i];
+            g.rect = getNodeRectangle(n);
+            g.visible = g.rect.Overlaps(cullRect);
+            vec2 *p = g.connectorPositions;
+            for (const auto &c : n->type->inputs) *p++ = connectorPosition(n, c);
+            for (const auto &c : n->type->outputs) *p++ = connectorPosition(n, c);
+            for (const auto &c : n->additionalInputs) *p++ = connectorPosition(n, c);
+            for (const auto &c : n->additionalOutputs) *p++ = connectorPosition(n, c);
+        }
+    };
+    // edges are done in two passes: first culling + level of detail, then (after allocating the points) tessellation.
+    auto cullEdges = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            EdgeGeometry &g = edgeGeometry[i];
+            const Connection &c = *g.connection;
+            vec2 p0 = connectorPosition(c.dstNode, c.input), p1 = connectorPosition(c.srcNode, c.output);
             float xDiff = abs(p0.x - p1.x) * .6;
-            vec2 p0b = p0 - vec2(xDiff, 0), p1b = p1 + vec2(xDiff, 0);
-            drawList->AddBezierCurve(p0, p0b, p1b, p1, outlineColor, zoom * 4);
-            drawList->AddBezierCurve(p0, p0b, p1b, p1, ImColor(vec4(1)), zoom * 2.5);
+            // the control points are the bounding box of the curve:
+            ImRect bounds(min(p0, p1) - vec2(xDiff, 0), max(p0, p1) + vec2(xDiff, 0));
+            g.nrOfPoints = bounds.Overlaps(cullRect) ? connectionSegments(p0, p1) + 1 : 0;
         }
+    };
+    auto allocateEdgePoints = [&] {
+        for (size_t i = 0; i < nrOfEdges; i++)
+            if (edgeGeometry[i].nrOfPoints) edgeGeometry[i].points = frameArena.allocArray<ImVec2>(edgeGeometry[i].nrOfPoints);
+    };
+    auto tessellateEdges = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            EdgeGeometry &g = edgeGeometry[i];
+            if (!g.nrOfPoints) continue;
+            const Connection &c = *g.connection;
+            tessellateConnection(connectorPosition(c.dstNode, c.input), connectorPosition(c.srcNode, c.output), g.nrOfPoints - 1, g.points);
+        }
+    };
+
+    if (nodes.size() >= parallelPrepareThreshold)
+    {
+        if (!framePool)
+        {
+            unsigned threads = std::thread::hardware_concurrency();
+            framePool = std::make_unique<ThreadPool>(threads > 1 ? threads - 1 : 0);
+        }
+        framePool->parallelFor(nodes.size(), prepareNodes);
+        framePool->parallelFor(nrOfEdges, cullEdges);
+        allocateEdgePoints();
+        framePool->parallelFor(nrOfEdges, tessellateEdges);
+    }
+    else
+    {
+        prepareNodes(0, nodes.size());
+        cullEdges(0, nrOfEdges);
+        allocateEdgePoints();
+        tessellateEdges(0, nrOfEdges);
     }
 }
 
@@ -608,6 +941,8 @@ void NodeEditor::deleteConnection(Connection &c)
 json NodeEditor::toJson(Nodes nodes)
 {
     json out;
+    std::unordered_map<const Node_ *, int> ids;
+    for (int i = 0; i < nodes.size(); i++) ids[nodes[i].get()] = i;
     int id = 0;
     for (Node n : nodes)
     {
@@ -644,10 +979,9 @@ json NodeEditor::toJson(Nodes nodes)
             json cj;
             cj["input"] = conn.input->name;
             cj["output"] = conn.output->name;
-            int dstNode;
-            for (dstNode = 0; dstNode < nodes.size(); dstNode++) if (nodes[dstNode] == conn.dstNode) break;
-            if (dstNode == nodes.size()) continue; // destination node not included in selection
-            cj["dstNode"] = dstNode;
+            auto dstNode = ids.find(conn.dstNode.get());
+            if (dstNode == ids.end()) continue; // destination node not included in selection
+            cj["dstNode"] = dstNode->second;
             connections.push_back(cj);
         }
         nj["outputConnections"] = connections;
@@ -723,6 +1057,113 @@ Nodes NodeEditor::fromJson(json input, bool &success)
     return nodes;
 }
 
+void NodeEditor::paste()
+{
+    // every paste is placed a bit further from the copied nodes:
+    clipboard->nrOfPastes++;
+    pasting = std::make_unique<ClipboardPaste>(clipboard, clipboard->origin + vec2(100) * float(clipboard->nrOfPastes),
+                                               nodeTypes, valueTypes);
+    if (!pasting->isValid())
+    {
+        std::cout << "pasting nodes unsuccessful, their types are unknown to this editor\n";
+        pasting = NULL;
+    }
+}
+
+void NodeEditor::updatePaste()
+{
+    if (!pasting->step(pasteStepsPerFrame))
+    {
+        ImGui::SetCursorScreenPos(pos + vec2(10, ImGui::GetWindowSize().y - 30));
+        ImGui::ProgressBar(
+                float(pasting->getNrOfStepsDone()) / pasting->getNrOfSteps(), vec2(300, 0),
+                frameArena.format("pasting %d nodes...", int(pasting->getNrOfNodes()))
+        );
+        return;
+    }
+    // one bulk insert, and one history entry for the whole paste:
+    nodes.insert(nodes.end(), pasting->nodes.begin(), pasting->nodes.end());
+    for (auto &n : pasting->nodes) minimap.update(n);
+    selectedNodes = pasting->nodes;
+    // toJson() of the whole graph would freeze this frame, store the paste on top of the previous entry instead:
+    addHistory({json(), pasting->getClipboard(), pasting->getOrigin()});
+    pasting = NULL;
+    graphChanged(false, true);
+}
+
+bool NodeEditor::applyPatch(const GraphPatch &patch)
+{
+    // the references are merkle hashes of the unpatched graph, so resolve all of them before changing anything:
+    std::vector<GraphPatch::NodeRef> refs = patch.removedNodes;
+    for (auto &l : patch.layoutChanges) refs.push_back(l.node);
+    for (int i = 0; i < 2; i++) for (auto &c : i ? patch.addedConnections : patch.removedConnections)
+    {
+        if (c.src.added < 0) refs.push_back(c.src.existing);
+        if (c.dst.added < 0) refs.push_back(c.dst.existing);
+    }
+    Nodes resolved = resolveNodeRefs(nodes, refs);
+    for (auto &n : resolved) if (!n) return false;
+
+    bool success = true;
+    Nodes added = patch.addedNodes.empty() ? Nodes() : fromJson(patch.addedNodes, success);
+    if (!success) return false;
+
+    // take the resolved nodes in the same order as they were collected:
+    int r = 0;
+    auto patchNode = [&](const GraphPatch::PatchNode &pn) { return pn.added >= 0 ? added[pn.added] : resolved[r++]; };
+
+    Nodes removed(resolved.begin(), resolved.begin() + patch.removedNodes.size());
+    r = removed.size();
+    for (auto &l : patch.layoutChanges)
+    {
+        Node n = resolved[r++];
+        n->position = l.position;
+        n->size = l.size;
+        n->collapsed = l.collapsed;
+        minimap.update(n);
+    }
+    for (auto &c : patch.removedConnections)
+    {
+        Node src = patchNode(c.src), dst = patchNode(c.dst);
+        for (auto &conn : src->connections)
+        {
+            if (conn.dstNode != dst || conn.output->name != c.output || conn.input->name != c.input) continue;
+            Connection toDelete = conn;
+            deleteConnection(toDelete);
+            break;
+        }
+    }
+    if (!removed.empty()) deleteNodes(removed);
+    for (auto &n : added)
+    {
+        nodes.push_back(n);
+        minimap.update(n);
+    }
+    for (auto &c : patch.addedConnections)
+    {
+        Connection conn;
+        conn.srcNode = patchNode(c.src);
+        conn.dstNode = patchNode(c.dst);
+        // (connectorByName() would also find an input with the output's name)
+        auto byName = [](const std::vector<NodeConnector> &a, const std::vector<NodeConnector> &b, const std::string &name) {
+            for (auto &list : {&a, &b}) for (auto &connector : *list) if (connector->name == name) return connector;
+            return NodeConnector();
+        };
+        conn.output = byName(conn.srcNode->type->outputs, conn.srcNode->additionalOutputs, c.output);
+        conn.input = byName(conn.dstNode->type->inputs, conn.dstNode->additionalInputs, c.input);
+        // the same checks as when the user makes the connection:
+        if (!conn.output || !conn.input || connectionProblem(conn))
+        {
+            success = false;
+            continue;
+        }
+        conn.srcNode->connections.push_back(conn);
+        conn.dstNode->connections.push_back(conn);
+    }
+    createHistory();
+    return success;
+}
+
 NodeConnector NodeEditor::connectorByName(Node n, std::string name)
 {
     for (const auto& c : n->type->inputs) if (c->name == name) return c;
@@ -733,40 +1174,176 @@ NodeConnector NodeEditor::connectorByName(Node n, std::string name)
 }
 
 void NodeEditor::createHistory()
+{
+    addHistory({toJson(nodes)});
+    graphChanged();
+}
+
+void NodeEditor::addHistory(HistoryEntry entry)
 {
     while (historyI != history.size() - 1)
         history.pop_back();
-    history.push_back(toJson(nodes));
+    history.push_back(std::move(entry));
     historyI = history.size() - 1;
     if (history.size() > 128)
     {
         int erase = 12;
+        // the new first entry can't build on erased ones:
+        if (history[erase].pasted)
+        {
+            bool success;
+            Nodes restored = restoreHistory(erase, success);
+            if (success) history[erase] = {toJson(restored)};
+        }
         history.erase(history.begin(), history.begin() + erase);
         historyI -= erase;
     }
 }
 
+Nodes NodeEditor::restoreHistory(int i, bool &success)
+{
+    const HistoryEntry &entry = history[i];
+    if (!entry.pasted) return fromJson(entry.nodes, success);
+
+    Nodes restored = restoreHistory(i - 1, success);
+    if (!success) return restored;
+    ClipboardPaste paste(entry.pasted, entry.pasteOrigin, nodeTypes, valueTypes);
+    paste.step(-1);
+    restored.insert(restored.end(), paste.nodes.begin(), paste.nodes.end());
+    return restored;
+}
+
+void NodeEditor::graphChanged(bool nodesReplaced, bool nodesAdded)
+{
+    version++;
+    if (nodesReplaced)
+    {
+        // the previews and profile belong to nodes that are gone:
+        if (previews) previews->clear();
+        profile.clear();
+        minimapSynced = false;
+    }
+    if (!evaluator) return;
+    // moving/resizing/collapsing nodes doesn't change the outcome of an evaluation.
+    // (after undo/redo the results belong to nodes that are gone, so always evaluate then.
+    // After a paste the hash is not computed, it costs as much as the paste, so the next change is evaluated too.)
+    if (nodesAdded)
+    {
+        evaluatedGraphHashKnown = false;
+        evaluate();
+        return;
+    }
+    uint64_t graphHash = hashGraph(nodes);
+    if (evaluatedGraphHashKnown && graphHash == evaluatedGraphHash && evaluation.valid() && !nodesReplaced) return;
+    evaluatedGraphHash = graphHash;
+    evaluatedGraphHashKnown = true;
+    evaluate();
+}
+
+void NodeEditor::evaluate()
+{
+    if (!evaluator) return;
+    auto deadline = evaluationTimeLimit > 0
+            ? std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(evaluationTimeLimit))
+            : std::chrono::steady_clock::time_point::max();
+    profile.clear(); // only show the newest evaluation
+    evaluation = evaluator->evaluate(nodes, version, deadline);
+    evaluationPending = true;
+}
+
+static bool isReady(const std::shared_future<EvaluationResult> &f)
+{
+    return f.valid() && f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool NodeEditor::FrameState::operator==(const FrameState &o) const
+{
+    return windowPos == o.windowPos && windowSize == o.windowSize && mousePos == o.mousePos && scroll == o.scroll
+           && zoom == o.zoom && version == o.version && hovering == o.hovering && active == o.active
+           && nrOfSelected == o.nrOfSelected && addMenuSelectedI == o.addMenuSelectedI && hasFocus == o.hasFocus
+           && addMenuOpen == o.addMenuOpen && showMinimap == o.showMinimap && showProfile == o.showProfile;
+}
+
+void NodeEditor::trackChanges()
+{
+    FrameState state;
+    state.windowPos = pos;
+    state.windowSize = ImGui::GetWindowSize();
+    state.mousePos = ImGui::GetMousePos();
+    state.scroll = scroll;
+    state.zoom = zoom;
+    state.version = version;
+    state.hovering = hoveringNode.get();
+    state.active = activeNode.get();
+    state.nrOfSelected = selectedNodes.size();
+    state.addMenuSelectedI = addMenuSelectedI;
+    state.hasFocus = hasFocus;
+    state.addMenuOpen = ImGui::IsPopupOpen(addMenuId.c_str());
+    state.showMinimap = showMinimap;
+    state.showProfile = showProfile;
+
+    // hover etc. is only known after things are drawn, so a frame that changed something needs one more frame:
+    changedLastFrame = !(state == drawnState);
+    drawnState = state;
+    redrawRequested = false;
+    if (evaluationPending && isReady(evaluation)) evaluationPending = false;
+    drawnPreviews = previews ? previews->getNrOfPublishes() : 0;
+    drawnProfileEvents = profiler ? profiler->getNrOfEvents() : 0;
+}
+
+bool NodeEditor::needsRedraw() const
+{
+    if (changedLastFrame || redrawRequested || version != drawnState.version) return true;
+    if (currentlyDragging || currentlyResizing || creatingConnection || selecting || draggingMinimap || pasting) return true;
+    if (hasFocus && ImGui::IsMouseDown(2)) return true; // scrolling
+    if (evaluationPending && isReady(evaluation)) return true;
+    if (previews && (previews->getNrOfPublishes() != drawnPreviews || previews->getNrOfPending())) return true;
+    if (showProfile && profiler && profiler->getNrOfEvents() != drawnProfileEvents) return true;
+    return false;
+}
+
+double NodeEditor::secondsUntilWakeup() const
+{
+    // results come from other threads without waking the host, so they have to be polled:
+    double wakeup = INFINITY;
+    if (evaluationPending || (showProfile && profiler)) wakeup = 1. / 30.;
+    if (previews) wakeup = min(wakeup, max(previews->minPublishInterval, 1. / 120.));
+    return wakeup;
+}
+
 void NodeEditor::undo()
 {
+    if (pasting)
+    {
+        pasting = NULL; // only cancel the paste, it isn't in the history yet
+        return;
+    }
     if (historyI <= 0) return;
     bool success;
-    Nodes oldNodes = fromJson(history[historyI - 1], success);
+    Nodes oldNodes = restoreHistory(historyI - 1, success);
     if (success)
     {
         historyI--;
         nodes = oldNodes;
+        graphChanged(true);
     }
 }
 
 void NodeEditor::redo()
 {
+    if (pasting)
+    {
+        pasting = NULL; // only cancel the paste, it isn't in the history yet
+        return;
+    }
     if (historyI >= history.size() - 1) return;
     bool success;
-    Nodes newerNodes = fromJson(history[historyI + 1], success);
+    Nodes newerNodes = restoreHistory(historyI + 1, success);
     if (success)
     {
         historyI++;
         nodes = newerNodes;
+        graphChanged(true);
     }
 }
 
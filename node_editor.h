@@ -2,12 +2,23 @@
 #define NODE_EDITOR_H
 
 #include "node.h"
+#include <unordered_map>
+#include <unordered_set>
+
 #include "imgui_includes.h"
+#include "frame_arena.h"
+#include "thread_pool.h"
+#include "preview_channel.h"
+#include "graph_diff.h"
+#include "async_evaluation.h"
+#include "minimap.h"
+#include "profiler.h"
+#include "clipboard.h"
 
 class NodeEditor
 {
   public:
-    static json copiedNodes;
+    static ClipboardPtr clipboard; // shared by all editors, set by Ctrl+C
 
     const std::string id;
 
@@ -18,16 +29,68 @@ class NodeEditor
     vec2 scroll;
     float zoom = 1;
     float zoomSpeed = 1;
-    
+
+    // Set by the host to evaluate the graph in the background. Every edit that changes the structure of the graph
+    // starts a new evaluation, cancelling the one that is running. The newest one is in `evaluation`.
+    std::shared_ptr<AsyncEvaluator> evaluator;
+    std::shared_future<EvaluationResult> evaluation;
+    float evaluationTimeLimit = 0; // seconds, 0 = no limit
+    uint64_t version = 0; // incremented after every edit
+
+    // starts evaluating the current nodes with `evaluator`, also if they did not change.
+    void evaluate();
+
+    // set by the host: values published here by an evaluator are shown on connections and output connectors
+    PreviewChannelPtr previews;
+
+    // set by the host, usually the same one as evaluator->profiler.
+    // With showProfile, nodes are tinted by their share of the evaluation time,
+    // and connections show how many bytes their source node produces per evaluation.
+    EvaluationProfilerPtr profiler;
+    bool showProfile = false;
+
+    // pastes with more nodes + connections than this are spread over multiple frames:
+    size_t pasteStepsPerFrame = 4096;
+
+    bool showMinimap = true;
+    vec2 minimapSize = vec2(220, 160);
+
+    // graphs with at least this many nodes compute their node and connection geometry on a thread pool:
+    size_t parallelPrepareThreshold = 512;
+
+    struct FrameStats
+    {
+        // heap allocations done during the last draw(), -1 if not compiled with NODE_EDITOR_COUNT_ALLOCATIONS
+        int heapAllocations = -1;
+        size_t arenaBytes = 0; // scratch memory taken from the frame arena during the last draw()
+    } lastFrameStats;
+
+    // --- idle frames: ---
+    // Hosts that redraw on input events only can skip frames while nothing changes:
+    // wait for input for at most secondsUntilWakeup(), and skip the frame if there was none and needsRedraw() is false.
+
+    // true if the last draw() changed state that shows up in the next frame (hover, selection, scroll, zoom, edits...),
+    // an interaction (dragging, resizing, connecting, selecting, scrolling) is going on, or the evaluation, previews or
+    // profiler produced something that wasn't drawn yet.
+    bool needsRedraw() const;
+
+    // seconds after which needsRedraw() should be checked again without input, INFINITY if it can't become true by itself.
+    double secondsUntilWakeup() const;
+
+    // for hosts that change `nodes` (or anything else the editor draws) directly.
+    void requestRedraw() { redrawRequested = true; }
+    // ---
+
     NodeEditor(Nodes nodes, std::vector<NodeType> nodeTypes, std::vector<NodeValueType> valueTypes);
 
     void draw(ImDrawList* drawList);
 
     void deleteNode(Node node);
+    void deleteNodes(Nodes toDelete); // also removes them from the selection
 
     void deleteConnection(Connection &c);
 
-    bool isSelected(Node node);
+    bool isSelected(const Node &node);
 
     bool containsLoop();
 
@@ -35,22 +98,66 @@ class NodeEditor
 
     Nodes fromJson(json input, bool &success);
 
+    // Applies a patch made by diffGraphs() against the current nodes. Returns false if the nodes it refers to
+    // can't be found or are ambiguous (nothing is changed then), or if some of the added connections could not be made
+    // (missing connectors, or rejected by connectionProblem(), like connections made by the user).
+    bool applyPatch(const GraphPatch &patch);
+
   private:
     bool hasFocus = false, multiSelect = false;
     vec2 pos, drawPos;
     vec2 mousePos, prevMousePos;
     vec2 dragDelta;
 
-    std::vector<json> history;
+    // scratch memory for a single frame, reset at the start of draw():
+    FrameArena frameArena;
+
+    // A snapshot made by toJson(), or the entry before it + a paste, so that big pastes don't have to be serialized.
+    struct HistoryEntry
+    {
+        json nodes;
+        ClipboardPtr pasted;
+        vec2 pasteOrigin;
+    };
+    std::vector<HistoryEntry> history;
     int historyI = -1;
 
+    ProfileSummary profile; // events of `profiler` collected so far
+
+    // --- change tracking: ---
+    // everything that decides what a frame looks like, apart from the nodes themselves (those are covered by `version`)
+    struct FrameState
+    {
+        vec2 windowPos, windowSize, mousePos, scroll;
+        float zoom = 0;
+        uint64_t version = -1;
+        const Node_ *hovering = NULL, *active = NULL;
+        size_t nrOfSelected = 0;
+        int addMenuSelectedI = -1;
+        bool hasFocus = false, addMenuOpen = false, showMinimap = false, showProfile = false;
+
+        bool operator==(const FrameState &o) const;
+    };
+    FrameState drawnState;
+    bool changedLastFrame = true, redrawRequested = false, evaluationPending = false;
+    uint64_t drawnPreviews = 0, drawnProfileEvents = 0;
+
+    void trackChanges(); // called at the end of draw()
+    // ---
+
     void createHistory(); // must be called after something happened.
+    void addHistory(HistoryEntry entry);
+    Nodes restoreHistory(int i, bool &success);
+    // called by createHistory(), undo() and redo(). nodesAdded: the structure changed for sure, don't hash the graph.
+    void graphChanged(bool nodesReplaced = false, bool nodesAdded = false);
+    uint64_t evaluatedGraphHash = 0;
+    bool evaluatedGraphHashKnown = false;
     void undo();
     void redo();
 
     // --- add node menu: ---
     std::string filter;
-    const char *addMenuId;
+    const std::string addMenuId;
     vec2 addPos;
     int addMenuSelectedI = -1;
 
@@ -65,31 +172,94 @@ class NodeEditor
 
     Node currentlyDragging;
 
+    // --- frame preparation: ---
+    // Geometry that does not depend on interaction is computed by prepareFrame() before anything is drawn.
+    // For large graphs this is done in parallel, the draw functions then only append it to the ImDrawList.
+    // Both arrays live in the frame arena.
+    struct NodeGeometry
+    {
+        ImRect rect;
+        vec2 *connectorPositions; // in the order of drawNodeConnectors()
+        bool visible;
+    };
+    NodeGeometry *nodeGeometry = NULL; // same indices as `nodes`
+
+    struct EdgeGeometry
+    {
+        const Connection *connection;
+        ImVec2 *points; // tessellated bezier curve
+        int nrOfPoints; // 0 if the connection is not in view
+    };
+    EdgeGeometry *edgeGeometry = NULL;
+    size_t nrOfEdges = 0;
+
+    std::unique_ptr<ThreadPool> framePool;
+
+    void prepareFrame();
+    // ---
+
     void updateNode(int i);
-    void drawNode(Node node, ImDrawList *drawList);
-    void resizeNode(Node node, ImDrawList *drawList);
-    void dragNode(Node node, ImDrawList *drawList, float dragBarRounding);
-    void drawNodeConnectors(Node node, ImDrawList *drawList);
+    void drawNode(const Node &node, const NodeGeometry &geometry, ImDrawList *drawList);
+    void resizeNode(const Node &node, ImDrawList *drawList);
+    void dragNode(const Node &node, ImDrawList *drawList, float dragBarRounding);
+    void drawNodeConnectors(const Node &node, const NodeGeometry &geometry, ImDrawList *drawList);
 
-    void drawNodeConnector(Node node, NodeConnector c, ImDrawList *drawList);
+    void drawNodeConnector(const Node &node, const NodeConnector &c, vec2 pos, ImDrawList *drawList);
+    void drawOutputPreview(const Node &node, const NodeConnector &c, vec2 pos, ImDrawList *drawList);
 
     void drawConnections(ImDrawList *drawList);
 
-    vec2 connectorPosition(Node node, NodeConnector c);
-    bool isInput(Node node, NodeConnector c);
-    bool isConnected(Node n, NodeConnector c);
+    vec2 connectorPosition(const Node &node, const NodeConnector &c);
+    bool isInput(const Node &node, const NodeConnector &c);
+    bool isConnected(const Node &n, const NodeConnector &c);
 
-    ImRect getNodeRectangle(Node node);
+    ImRect getNodeRectangle(const Node &node);
 
     void updateZoom();
     void drawBackground(ImDrawList *drawList);
 
+    // --- minimap: ---
+    Minimap minimap;
+    bool minimapSynced = false; // false: check every node, see updateMinimap()
+    bool draggingMinimap = false, mouseOverMinimap = false;
+
+    ImRect getMinimapRectangle();
+    void updateMinimap(ImDrawList *drawList);
+    // ---
+
     bool selecting = false;
     Nodes selectedNodes;
     void updateSelection(ImDrawList *drawList);
 
+    // the paste in progress, its nodes are added to the graph when it is done:
+    std::unique_ptr<ClipboardPaste> pasting;
+    void paste();
+    void updatePaste(); // continues pasting and shows the progress
+
+    // --- creating connections: ---
     std::unique_ptr<Connection> creatingConnection;
 
+    // Inputs that the connection being created can be connected to: compatible value type, not connected yet,
+    // and not upstream of the source node (that would create a loop).
+    // Built once by startConnection(), positions are in canvas space so they stay valid while scrolling/zooming.
+    struct ConnectionTarget
+    {
+        Node node;
+        NodeConnector input;
+        vec2 canvasPos;
+    };
+    std::vector<ConnectionTarget> connectionTargets;
+    std::unordered_map<uint64_t, std::vector<int>> connectionTargetGrid; // cell -> indices in connectionTargets
+    int snapTarget = -1;
+    std::unordered_set<const Node_ *> connectionUpstream; // nodes that can't be connected to, because of loops
+
+    // why `c` can't be made (wrong direction or value type, input already connected, loop), NULL if it can.
+    const char *connectionProblem(const Connection &c);
+
+    void startConnection(const Connection &partial);
+    void updateCreatingConnection(ImDrawList *drawList); // highlights targets, snaps to the nearest, connects on release
+    // ---
+
     // returns the connections that have this node as start/source/begin
     std::vector<Connection> getOutputConnections(Node n);
 
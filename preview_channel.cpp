@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "preview_channel.h"
+
+static double secondsSinceStart()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const char tombstoneAddress = 0;
+const Node_ *const PreviewChannel::TOMBSTONE = reinterpret_cast<const Node_ *>(&tombstoneAddress);
+
+PreviewChannel::PreviewChannel(size_t capacity, double minPublishInterval)
+    : minPublishInterval(minPublishInterval), slots(new Slot[capacity]), capacity(capacity)
+{}
+
+size_t PreviewChannel::hash(const Node_ *node, const NodeConnector_ *output) const
+{
+    size_t h = std::hash<const void *>()(node);
+    h ^= std::hash<const void *>()(output) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h % capacity;
+}
+
+bool PreviewChannel::tryLock(Slot &s, uint32_t &seq)
+{
+    seq = s.sequence.load(std::memory_order_relaxed);
+    if (seq & 1u || !s.sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+        return false;
+    // even -> odd must be visible before any of the stores that follow, or a reader could accept a torn payload:
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void PreviewChannel::lock(Slot &s, uint32_t &seq)
+{
+    while (!tryLock(s, seq)) std::this_thread::yield();
+}
+
+PreviewChannel::Slot *PreviewChannel::claim(const Node_ *node, const NodeConnector_ *output, uint32_t &seq)
+{
+    // the probe is done without holding slots, so check again once the slot is held:
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        Slot *found = NULL, *free = NULL; // free: first tombstone, or the empty slot that ends the probe
+        size_t start = hash(node, output);
+        for (size_t probe = 0; probe < capacity; probe++)
+        {
+            Slot &s = slots[(start + probe) % capacity];
+            const Node_ *slotNode = s.node.load(std::memory_order_acquire);
+            if (slotNode == node && s.connector.load(std::memory_order_acquire) == output)
+            {
+                found = &s;
+                break;
+            }
+            if (slotNode == TOMBSTONE && !free) free = &s;
+            if (!slotNode)
+            {
+                // keep a quarter of the table empty, so probes for missing keys stay short:
+                if (!free && nrOfUsed.load(std::memory_order_relaxed) < capacity * 3 / 4) free = &s;
+                break;
+            }
+        }
+        Slot *s = found ? found : free;
+        if (!s) return NULL; // full
+        if (!tryLock(*s, seq)) return NULL; // someone else is publishing to this slot, don't wait for it.
+
+        const Node_ *slotNode = s->node.load(std::memory_order_relaxed);
+        if (found && slotNode == node && s->connector.load(std::memory_order_relaxed) == output) return s;
+        if (!found && (!slotNode || slotNode == TOMBSTONE))
+        {
+            if (!slotNode) nrOfUsed++;
+            else nrOfTombstones--;
+            s->node.store(node, std::memory_order_relaxed);
+            s->connector.store(output, std::memory_order_relaxed);
+            return s;
+        }
+        unlock(*s, seq); // changed by someone else in the meantime
+    }
+    return NULL;
+}
+
+PreviewChannel::Slot *PreviewChannel::find(const Node_ *node, const NodeConnector_ *output) const
+{
+    size_t start = hash(node, output);
+    for (size_t probe = 0; probe < capacity; probe++)
+    {
+        Slot &s = slots[(start + probe) % capacity];
+        const Node_ *slotNode = s.node.load(std::memory_order_acquire);
+        if (!slotNode) return NULL;
+        if (slotNode == node && s.connector.load(std::memory_order_acquire) == output) return &s;
+    }
+    return NULL;
+}
+
+void PreviewChannel::show(Slot &s, const uint32_t *words, double now)
+{
+    for (int i = 0; i < PAYLOAD_WORDS; i++) s.payload[i].store(words[i], std::memory_order_relaxed);
+    s.hasValue.store(true, std::memory_order_relaxed);
+    s.lastPublishTime = now;
+    if (s.pending.load(std::memory_order_relaxed))
+    {
+        s.pending.store(false, std::memory_order_relaxed);
+        nrOfPending--;
+    }
+}
+
+void PreviewChannel::reset(Slot &s, const Node_ *key)
+{
+    const Node_ *old = s.node.load(std::memory_order_relaxed);
+    if (old == TOMBSTONE) nrOfTombstones--;
+    if (key == TOMBSTONE) nrOfTombstones++;
+    if (old && !key) nrOfUsed--;
+
+    s.node.store(key, std::memory_order_relaxed);
+    s.connector.store(NULL, std::memory_order_relaxed);
+    s.hasValue.store(false, std::memory_order_relaxed);
+    s.lastPublishTime = -1;
+    if (s.pending.load(std::memory_order_relaxed))
+    {
+        s.pending.store(false, std::memory_order_relaxed);
+        nrOfPending--;
+    }
+}
+
+bool PreviewChannel::publish(const Node_ *node, const NodeConnector_ *output, const ConnectorPreview &preview)
+{
+    // the editor draws these into fixed size arrays, don't trust the publisher:
+    ConnectorPreview checked = preview;
+    checked.nrOfSamples = std::max(0, std::min(checked.nrOfSamples, int(IM_ARRAYSIZE(checked.samples))));
+    checked.text[IM_ARRAYSIZE(checked.text) - 1] = 0;
+
+    uint32_t words[PAYLOAD_WORDS] = {};
+    memcpy(words, &checked, sizeof(ConnectorPreview));
+
+    uint32_t seq;
+    Slot *s = claim(node, output, seq);
+    if (!s) return false;
+
+    double now = secondsSinceStart();
+    bool throttled = s->lastPublishTime >= 0 && now - s->lastPublishTime < minPublishInterval;
+    if (throttled)
+    {
+        // keep the newest one, deliverPending() shows it when the interval has passed:
+        memcpy(s->pendingPayload, words, sizeof(words));
+        if (!s->pending.load(std::memory_order_relaxed))
+        {
+            s->pending.store(true, std::memory_order_release);
+            nrOfPending++;
+        }
+    }
+    else show(*s, words, now);
+
+    // odd -> even, the payload stores above can't be reordered after this:
+    unlock(*s, seq);
+    if (!throttled) nrOfPublishes.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool PreviewChannel::read(const Node_ *node, const NodeConnector_ *output, ConnectorPreview &out) const
+{
+    const Slot *s = find(node, output);
+    if (!s) return false;
+
+    uint32_t words[PAYLOAD_WORDS];
+    // A publish only takes a few hundred nanoseconds, but the publisher might get descheduled in the middle of one.
+    // Give up after a few tries instead of waiting for it, the preview will be there next frame.
+    for (int attempt = 0; attempt < 8; attempt++)
+    {
+        uint32_t before = s->sequence.load(std::memory_order_acquire);
+        if (before & 1u) continue;
+
+        // the slot might have been forgotten/reused since find():
+        bool valid = s->node.load(std::memory_order_relaxed) == node
+                     && s->connector.load(std::memory_order_relaxed) == output
+                     && s->hasValue.load(std::memory_order_relaxed);
+        if (valid) for (int i = 0; i < PAYLOAD_WORDS; i++) words[i] = s->payload[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->sequence.load(std::memory_order_relaxed) != before) continue;
+        if (!valid) return false;
+
+        memcpy(&out, words, sizeof(ConnectorPreview));
+        return true;
+    }
+    return false;
+}
+
+void PreviewChannel::deliverPending()
+{
+    if (nrOfPending.load(std::memory_order_acquire) == 0) return;
+    double now = secondsSinceStart();
+    for (size_t i = 0; i < capacity; i++)
+    {
+        Slot &s = slots[i];
+        uint32_t seq;
+        if (!s.pending.load(std::memory_order_acquire) || !tryLock(s, seq)) continue; // busy: try again next frame
+        bool due = s.pending.load(std::memory_order_relaxed) && now - s.lastPublishTime >= minPublishInterval;
+        if (due) show(s, s.pendingPayload, now);
+        unlock(s, seq);
+        if (due) nrOfPublishes.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void PreviewChannel::forget(const Node_ *node, const NodeConnector_ *output)
+{
+    Slot *s = find(node, output);
+    if (!s) return;
+    uint32_t seq;
+    lock(*s, seq);
+    // a tombstone keeps the probe sequences of other keys intact:
+    if (s->node.load(std::memory_order_relaxed) == node && s->connector.load(std::memory_order_relaxed) == output)
+        reset(*s, TOMBSTONE);
+    unlock(*s, seq);
+
+    // tombstones make probes longer, start over when there are many:
+    if (nrOfTombstones.load(std::memory_order_relaxed) > capacity / 4) clear();
+}
+
+void PreviewChannel::clear()
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        Slot &s = slots[i];
+        if (!s.node.load(std::memory_order_acquire)) continue;
+        uint32_t seq;
+        lock(s, seq);
+        if (s.node.load(std::memory_order_relaxed)) reset(s, NULL);
+        unlock(s, seq);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef PREVIEW_CHANNEL_H
+#define PREVIEW_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "node.h"
+
+/**
+ * Small, fixed-size summary of the value on an output connector, shown by the NodeEditor.
+ */
+struct ConnectorPreview
+{
+    char text[32] = "";             // e.g. "0.42" or "mesh (2k verts)"
+    float samples[32];              // optional, drawn as a small graph next to the connector
+    int nrOfSamples = 0;
+};
+
+/**
+ * Channel through which an evaluator (running on any thread) publishes previews of output values to a NodeEditor.
+ *
+ * Every (node, output connector) pair gets a slot in a fixed-size open addressing table.
+ * Slots are protected by a seqlock: publish() never waits for the UI, and read() never waits for the evaluator,
+ * it just retries when a publish happened during the copy.
+ * Slots of deleted nodes have to be freed with forget() or clear(), otherwise a new node at the same address
+ * could show the preview of the old one.
+ */
+class PreviewChannel
+{
+  public:
+    // minPublishInterval (seconds): a publish that comes sooner than this after the previous one to the same slot
+    // is kept as pending, and shown by deliverPending() once the interval has passed. Only the newest is kept.
+    explicit PreviewChannel(size_t capacity = 4096, double minPublishInterval = 1. / 30.);
+
+    // Called by the evaluator. Returns false if another thread was publishing to the same slot, or the table is full.
+    bool publish(const Node_ *node, const NodeConnector_ *output, const ConnectorPreview &preview);
+
+    // Called by the UI. Copies the latest published preview into `out`, returns false if nothing was published yet.
+    bool read(const Node_ *node, const NodeConnector_ *output, ConnectorPreview &out) const;
+
+    // Called by the UI every frame: shows the pending previews whose interval has passed.
+    void deliverPending();
+
+    // Called by the UI when the node (or connector) is gone.
+    void forget(const Node_ *node, const NodeConnector_ *output);
+
+    // Called by the UI when all nodes are replaced (undo/redo, loading).
+    void clear();
+
+    double minPublishInterval;
+
+    // number of previews that became visible so far, lets the UI see that something new is there without reading every slot.
+    uint64_t getNrOfPublishes() const { return nrOfPublishes.load(std::memory_order_acquire); }
+
+    // number of slots with a throttled preview that is not visible yet
+    int getNrOfPending() const { return nrOfPending.load(std::memory_order_acquire); }
+
+  private:
+    static const int PAYLOAD_WORDS = (sizeof(ConnectorPreview) + 3) / 4;
+
+    struct Slot
+    {
+        // The key is only changed while holding the sequence lock. NULL = never used, TOMBSTONE = forgotten.
+        std::atomic<const Node_ *> node {NULL};
+        std::atomic<const NodeConnector_ *> connector {NULL};
+        std::atomic<uint32_t> sequence {0}; // odd while someone holds the slot
+
+        // only touched while holding the slot:
+        double lastPublishTime = -1;
+        uint32_t pendingPayload[PAYLOAD_WORDS];
+        std::atomic<bool> pending {false}; // also read without holding the slot, by deliverPending()
+
+        // the payload is stored in atomic words so that reading while publishing is not a data race:
+        std::atomic<bool> hasValue {false};
+        std::atomic<uint32_t> payload[PAYLOAD_WORDS];
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity;
+    std::atomic<uint64_t> nrOfPublishes {0};
+    std::atomic<int> nrOfPending {0};
+    std::atomic<size_t> nrOfUsed {0}, nrOfTombstones {0}; // slots that are not NULL, and the ones of those that are TOMBSTONE
+
+    static const Node_ *const TOMBSTONE;
+
+    size_t hash(const Node_ *node, const NodeConnector_ *output) const;
+    Slot *claim(const Node_ *node, const NodeConnector_ *output, uint32_t &seq); // returns the slot held, see lock()
+    Slot *find(const Node_ *node, const NodeConnector_ *output) const;
+
+    static bool tryLock(Slot &s, uint32_t &seq);
+    static void lock(Slot &s, uint32_t &seq); // only used by the UI, publishers hold a slot very shortly
+    static void unlock(Slot &s, uint32_t seq) { s.sequence.store(seq + 2, std::memory_order_release); }
+
+    void show(Slot &s, const uint32_t *words, double now); // slot must be held
+    void reset(Slot &s, const Node_ *key); // slot must be held, key is NULL or TOMBSTONE
+};
+
+typedef std::shared_ptr<PreviewChannel> PreviewChannelPtr;
+
+#endif
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+#include "clipboard.h"
+#include "process_evaluation.h"
+
+// Job: int64 deadline (steady clock nanoseconds, INT64_MAX if none), then the clipboard in CBOR.
+// Result: per node, in clipboard order: uint8 evaluated, and if so: int64 start, int64 duration, int32 number of
+// outputs, then per output: double number, int64 buffer size (-1 if no buffer), buffer data.
+
+template <class T>
+static void put(std::vector<char> &out, const T &value)
+{
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+struct ResultReader
+{
+    const std::vector<char> &data;
+    size_t pos = 0;
+    bool ok = true;
+
+    template <class T>
+    T get()
+    {
+        T value = T();
+        if (pos + sizeof(T) > data.size()) ok = false;
+        else memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    const char *skip(size_t n)
+    {
+        if (pos + n > data.size()) ok = false;
+        const char *p = ok ? data.data() + pos : NULL;
+        pos += n;
+        return p;
+    }
+};
+
+ProcessEvaluator::ProcessEvaluator(int nrOfWorkers, const std::vector<NodeType> &nodeTypes,
+                                   const std::vector<NodeValueType> &valueTypes, size_t ringSize)
+    : nodeTypes(nodeTypes), valueTypes(valueTypes)
+{
+    // the workers are forked from the pool, so the types have to be set before it is created:
+    pool = std::make_unique<ProcessPool>(nrOfWorkers, [this](const std::vector<char> &input, std::vector<char> &output,
+                                                             const std::atomic<bool> &cancel) {
+        return evaluateJob(input, output, cancel);
+    }, ringSize);
+}
+
+bool ProcessEvaluator::evaluateJob(const std::vector<char> &input, std::vector<char> &output,
+                                   const std::atomic<bool> &cancel) const
+{
+    if (input.size() < sizeof(int64_t)) return false;
+    int64_t deadlineNs;
+    memcpy(&deadlineNs, input.data(), sizeof(int64_t));
+    json j = json::from_cbor(std::vector<uint8_t>(input.begin() + sizeof(int64_t), input.end()));
+
+    ClipboardPtr clipboard = clipboardFromJson(j, nodeTypes, valueTypes);
+    if (!clipboard) return false;
+    ClipboardPaste paste(clipboard, clipboard->origin, nodeTypes, valueTypes);
+    if (!paste.isValid()) return false;
+    paste.step(-1);
+
+    GraphEvaluator evaluator;
+    evaluator.profiler = std::make_shared<EvaluationProfiler>(paste.nodes.size() + 1); // big enough to keep every event
+    if (!evaluator.compile(paste.nodes)) return false;
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (deadlineNs != INT64_MAX) deadline = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadlineNs));
+    evaluator.evaluate(&cancel, deadline);
+
+    std::unordered_map<const Node_ *, EvaluationProfiler::Event> events;
+    for (uint64_t i = 0; i < evaluator.profiler->getNrOfEvents(); i++)
+    {
+        EvaluationProfiler::Event e;
+        if (evaluator.profiler->read(i, e)) events[e.node] = e;
+    }
+    for (auto &n : paste.nodes)
+    {
+        bool evaluated = evaluator.isEvaluated(n.get());
+        put<uint8_t>(output, evaluated);
+        if (!evaluated) continue;
+
+        auto e = events.find(n.get());
+        put<int64_t>(output, e == events.end() ? 0 : e->second.startNs);
+        put<int64_t>(output, e == events.end() ? 0 : e->second.durationNs);
+        put<int32_t>(output, n->type->outputs.size() + n->additionalOutputs.size());
+        for (int i = 0; i < 2; i++) for (auto &c : i ? n->additionalOutputs : n->type->outputs)
+        {
+            const Value *v = evaluator.getOutput(n.get(), c.get());
+            put<double>(output, v->number);
+            put<int64_t>(output, v->buffer ? int64_t(v->buffer.size()) : -1);
+            if (v->buffer) output.insert(output.end(), v->buffer.as<char>(), v->buffer.as<char>() + v->buffer.size());
+        }
+    }
+    return true;
+}
+
+ProcessEvaluator::Job ProcessEvaluator::serialize(const Nodes &nodes) const
+{
+    // independent subgraphs, with union-find over the connections:
+    std::unordered_map<const Node_ *, int> index;
+    for (int i = 0; i < nodes.size(); i++) index[nodes[i].get()] = i;
+    std::vector<int> parent(nodes.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    for (int i = 0; i < nodes.size(); i++) for (auto &c : nodes[i]->connections)
+    {
+        auto dst = index.find(c.dstNode.get());
+        if (c.srcNode == nodes[i] && dst != index.end()) parent[find(i)] = find(dst->second);
+    }
+    std::unordered_map<int, Nodes> subgraphs;
+    for (int i = 0; i < nodes.size(); i++) subgraphs[find(i)].push_back(nodes[i]);
+
+    // biggest first, each to the part with the fewest nodes so far:
+    std::vector<Nodes *> bySize;
+    for (auto &s : subgraphs) bySize.push_back(&s.second);
+    std::sort(bySize.begin(), bySize.end(), [](Nodes *a, Nodes *b) { return a->size() > b->size(); });
+    Job job;
+    job.nodes.resize(std::min<size_t>(bySize.size(), std::max(1, pool->getNrOfWorkers())));
+    for (Nodes *s : bySize)
+    {
+        Nodes &part = *std::min_element(job.nodes.begin(), job.nodes.end(), [](const Nodes &a, const Nodes &b) { return a.size() < b.size(); });
+        part.insert(part.end(), s->begin(), s->end());
+    }
+    for (auto &part : job.nodes)
+    {
+        std::vector<char> input(sizeof(int64_t)); // deadline, filled in by evaluate()
+        std::vector<uint8_t> cbor = json::to_cbor(copyToClipboard(part)->toJson());
+        input.insert(input.end(), cbor.begin(), cbor.end());
+        job.inputs.push_back(std::move(input));
+    }
+    return job;
+}
+
+bool ProcessEvaluator::evaluate(GraphEvaluator &target, Job &job, const std::atomic<bool> *cancel,
+                                std::chrono::steady_clock::time_point deadline)
+{
+    bool checkDeadline = deadline != std::chrono::steady_clock::time_point::max();
+    int64_t deadlineNs = checkDeadline ? std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count() : INT64_MAX;
+
+    std::vector<int64_t> ids;
+    auto abandon = [&]() {
+        if (!ids.empty()) pool->cancelUpTo(ids.back()); // so the newer jobs don't wait behind these
+        return false;
+    };
+    for (auto &input : job.inputs)
+    {
+        memcpy(input.data(), &deadlineNs, sizeof(int64_t));
+        int64_t id = pool->submit(input);
+        if (id < 0) return abandon();
+        ids.push_back(id);
+    }
+    auto giveUp = deadline;
+    if (checkDeadline) giveUp += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(resultGrace));
+
+    std::vector<ProcessPool::Result> results(ids.size());
+    size_t nrOfReceived = 0;
+    while (nrOfReceived < ids.size())
+    {
+        if (cancel && cancel->load(std::memory_order_relaxed)) return abandon();
+        if (checkDeadline && std::chrono::steady_clock::now() >= giveUp) return abandon();
+
+        pool->poll();
+        ProcessPool::Result result;
+        while (pool->popResult(result))
+        {
+            // results of abandoned jobs are dropped:
+            auto it = std::find(ids.begin(), ids.end(), result.job);
+            if (it == ids.end()) continue;
+            results[it - ids.begin()] = std::move(result);
+            nrOfReceived++;
+        }
+        if (nrOfReceived < ids.size()) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    // where the outputs of every node start in the results:
+    std::unordered_map<const Node_ *, std::pair<const std::vector<char> *, size_t>> offsets;
+    for (int p = 0; p < results.size(); p++)
+    {
+        if (!results[p].success) return false;
+        ResultReader reader {results[p].output};
+        for (auto &n : job.nodes[p])
+        {
+            if (!reader.get<uint8_t>()) continue;
+            offsets[n.get()] = {&results[p].output, reader.pos};
+            reader.skip(2 * sizeof(int64_t));
+            int nrOfOutputs = reader.get<int32_t>();
+            for (int i = 0; i < nrOfOutputs; i++)
+            {
+                reader.get<double>();
+                int64_t size = reader.get<int64_t>();
+                if (size > 0) reader.skip(size);
+            }
+            if (!reader.ok) return false;
+        }
+    }
+    return target.setOutputs([&](const Node_ &node, Value *outputs, int nrOfOutputs) {
+        auto offset = offsets.find(&node);
+        if (offset == offsets.end()) return false;
+        ResultReader reader {*offset->second.first, offset->second.second};
+        int64_t start = reader.get<int64_t>(), duration = reader.get<int64_t>();
+        if (reader.get<int32_t>() != nrOfOutputs) return false;
+        uint64_t bytes = 0;
+        for (int i = 0; i < nrOfOutputs; i++)
+        {
+            outputs[i].number = reader.get<double>();
+            int64_t size = reader.get<int64_t>();
+            if (size >= 0)
+            {
+                outputs[i].buffer = target.getPool().allocate(size);
+                if (size > 0) memcpy(outputs[i].buffer.mutableData(), reader.skip(size), size);
+            }
+            bytes += outputs[i].size();
+        }
+        // steady_clock is the same in every process, so the events line up with local ones:
+        if (target.profiler) target.profiler->record(&node, start, duration, bytes);
+        return true;
+    });
+}
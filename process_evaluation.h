@@ -0,0 +1,60 @@
+#ifndef PROCESS_EVALUATION_H
+#define PROCESS_EVALUATION_H
+
+#include <memory>
+
+#include "evaluation.h"
+#include "process_pool.h"
+
+/**
+ * Evaluates graphs in worker processes (see ProcessPool), so that a NodeFunction that crashes or hangs doesn't take
+ * the editor down.
+ *
+ * The nodes are split into independent subgraphs (no connections between them), which are divided over the workers.
+ * Every part is sent as a clipboard (CBOR), the worker pastes it with its own copy of the node types, evaluates it and
+ * sends back the output values. Those are put into the GraphEvaluator the nodes were compiled with, so the results are
+ * used the same way as those of a local evaluation. Branches of one connected subgraph are not split up.
+ *
+ * Create it before any threads are started (ThreadPool, AsyncEvaluator...), and set AsyncEvaluator::processes to use it.
+ */
+class ProcessEvaluator
+{
+  public:
+    // ringSize has to fit a serialized part, and all output values of it.
+    ProcessEvaluator(int nrOfWorkers, const std::vector<NodeType> &nodeTypes,
+                     const std::vector<NodeValueType> &valueTypes, size_t ringSize = 64 << 20);
+
+    bool isValid() const { return pool->isValid(); }
+
+    struct Job
+    {
+        std::vector<std::vector<char>> inputs; // one per part
+        std::vector<Nodes> nodes; // per part, same order as in its clipboard
+    };
+
+    // Reads the graph, so call it on the thread that edits the graph, together with GraphEvaluator::compile().
+    Job serialize(const Nodes &nodes) const;
+
+    // Evaluates a serialized job and puts the outputs in `target`, which must have been compiled with the same nodes.
+    // Only reads `job`, never the nodes themselves, so it can run on another thread than the one editing the graph.
+    // Blocks until every part is done. The workers stop at the deadline and send back the nodes evaluated so far.
+    // When `cancel` becomes true, or not all parts arrived `resultGrace` seconds after the deadline, the parts are
+    // cancelled in the workers too, and false is returned. Also returns false if a worker crashed or was killed,
+    // `target` then has no outputs.
+    bool evaluate(GraphEvaluator &target, Job &job, const std::atomic<bool> *cancel = NULL,
+                  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    double resultGrace = .05;
+
+    // set heartbeatTimeout/jobTimeout here. Only use it from the thread that calls evaluate().
+    std::unique_ptr<ProcessPool> pool;
+
+  private:
+    std::vector<NodeType> nodeTypes;
+    std::vector<NodeValueType> valueTypes;
+
+    // runs in a worker
+    bool evaluateJob(const std::vector<char> &input, std::vector<char> &output, const std::atomic<bool> &cancel) const;
+};
+
+#endif
@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <dirent.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "process_pool.h"
+
+// Single producer/single consumer byte ring in shared memory. head and tail only grow, their difference is the fill.
+// (lock-free std::atomics on plain integers work between processes.)
+struct SharedRing
+{
+    std::atomic<uint64_t> head {0}, tail {0};
+    uint64_t capacity;
+
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+struct ProcessPool::Shared
+{
+    std::atomic<int64_t> heartbeat {0}; // steady_clock nanoseconds, written by a thread in the worker
+    std::atomic<int64_t> jobStarted {0}; // when the worker started its current job, 0 while idle
+    std::atomic<int64_t> cancelUpTo {-1}; // jobs with an id <= this one are cancelled
+    std::atomic<int> stop {0};
+    sem_t jobsAvailable; // posted for every job written to `jobs`, and to stop the worker
+
+    // the host increments spawnRequest, the zygote forks a worker and sets spawned to it:
+    std::atomic<int> spawnRequest {0}, spawned {0};
+    std::atomic<pid_t> pid {-1};
+    std::atomic<int> exited {1}; // set by the zygote when it reaped the worker
+
+    SharedRing *jobs, *results; // point into the same mapping, which has the same address in the forked processes
+};
+
+struct ProcessPool::Control
+{
+    std::atomic<int> stop {0};
+    sem_t wake; // wakes the zygote: posted for spawn requests, to stop it, and by its SIGCHLD handler
+};
+
+struct MessageHeader
+{
+    int64_t job;
+    uint32_t size;
+    uint32_t success;
+};
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int countThreads()
+{
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) return -1;
+    int n = 0;
+    while (dirent *entry = readdir(dir)) if (entry->d_name[0] != '.') n++;
+    closedir(dir);
+    return n;
+}
+
+static void ringCopyIn(SharedRing *r, uint64_t pos, const void *src, size_t n);
+static void ringCopyOut(SharedRing *r, uint64_t pos, void *dst, size_t n);
+
+static bool ringWrite(SharedRing *r, const MessageHeader &h, const char *payload)
+{
+    uint64_t head = r->head.load(std::memory_order_relaxed), tail = r->tail.load(std::memory_order_acquire);
+    size_t total = sizeof(MessageHeader) + h.size;
+    if (r->capacity - (head - tail) < total) return false;
+
+    ringCopyIn(r, head, &h, sizeof(MessageHeader));
+    ringCopyIn(r, head + sizeof(MessageHeader), payload, h.size);
+    r->head.store(head + total, std::memory_order_release);
+    return true;
+}
+
+static bool ringRead(SharedRing *r, MessageHeader &h, std::vector<char> &payload)
+{
+    uint64_t tail = r->tail.load(std::memory_order_relaxed), head = r->head.load(std::memory_order_acquire);
+    if (head == tail) return false;
+
+    ringCopyOut(r, tail, &h, sizeof(MessageHeader));
+    payload.resize(h.size);
+    ringCopyOut(r, tail + sizeof(MessageHeader), payload.data(), h.size);
+    r->tail.store(tail + sizeof(MessageHeader) + h.size, std::memory_order_release);
+    return true;
+}
+
+static void ringCopyIn(SharedRing *r, uint64_t pos, const void *src, size_t n)
+{
+    size_t offset = pos % r->capacity, first = n < r->capacity - offset ? n : r->capacity - offset;
+    memcpy(r->data() + offset, src, first);
+    memcpy(r->data(), static_cast<const char *>(src) + first, n - first);
+}
+
+static void ringCopyOut(SharedRing *r, uint64_t pos, void *dst, size_t n)
+{
+    size_t offset = pos % r->capacity, first = n < r->capacity - offset ? n : r->capacity - offset;
+    memcpy(dst, r->data() + offset, first);
+    memcpy(static_cast<char *>(dst) + first, r->data(), n - first);
+}
+
+size_t ProcessPool::mappingSize() const
+{
+    size_t ringBytes = ((sizeof(SharedRing) + ringSize) + 63) & ~size_t(63);
+    return ((sizeof(Shared) + 63) & ~size_t(63)) + 2 * ringBytes;
+}
+
+ProcessPool::ProcessPool(int nrOfWorkers, Handler handler, size_t ringSize)
+    : handler(handler), ringSize(ringSize), workers(nrOfWorkers)
+{
+    // fork() only copies the calling thread, a lock held by another thread stays locked forever in the child:
+    int nrOfThreads = countThreads();
+    if (nrOfThreads != 1)
+    {
+        std::cout << "ProcessPool: not starting workers, the process already has " << nrOfThreads
+                  << " threads. Create the pool before starting any threads.\n";
+        workers.clear();
+        return;
+    }
+    void *mem = mmap(NULL, sizeof(Control), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return;
+    control = new (mem) Control;
+    sem_init(&control->wake, 1, 0);
+
+    size_t ringBytes = ((sizeof(SharedRing) + ringSize) + 63) & ~size_t(63);
+    for (auto &w : workers)
+    {
+        mem = mmap(NULL, mappingSize(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) continue; // this worker will never get jobs
+        char *bytes = static_cast<char *>(mem);
+        w.shared = new (bytes) Shared;
+        w.shared->jobs = new (bytes + ((sizeof(Shared) + 63) & ~size_t(63))) SharedRing;
+        w.shared->results = new (reinterpret_cast<char *>(w.shared->jobs) + ringBytes) SharedRing;
+        w.shared->jobs->capacity = w.shared->results->capacity = ringSize;
+        sem_init(&w.shared->jobsAvailable, 1, 0);
+    }
+    // the zygote is a copy of this process while it is still single threaded, workers are forked from it later:
+    pid_t host = getpid();
+    zygote = fork();
+    if (zygote == 0)
+    {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != host) _exit(0); // the host died before prctl()
+        zygoteMain();
+        _exit(0); // don't run the host's atexit handlers/destructors.
+    }
+    if (zygote < 0) std::cout << "ProcessPool: could not fork the zygote: " << strerror(errno) << '\n';
+    for (auto &w : workers) if (w.shared) start(w);
+}
+
+ProcessPool::~ProcessPool()
+{
+    if (zygote > 0)
+    {
+        for (auto &w : workers) if (w.shared)
+        {
+            w.shared->stop = 1;
+            sem_post(&w.shared->jobsAvailable);
+        }
+
+        // give the workers a second to finish their job and exit by themselves:
+        for (int i = 0; i < 100; i++)
+        {
+            bool allExited = true;
+            for (auto &w : workers) if (w.shared && !w.shared->exited) allExited = false;
+            if (allExited) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        control->stop = 1; // the zygote kills the workers that are still running
+        sem_post(&control->wake);
+        waitpid(zygote, NULL, 0);
+    }
+    for (auto &w : workers) if (w.shared) munmap(w.shared, mappingSize());
+    if (control) munmap(control, sizeof(Control));
+}
+
+static sem_t *zygoteWake = NULL;
+
+static void onChildExit(int)
+{
+    int e = errno;
+    sem_post(zygoteWake); // async-signal-safe
+    errno = e;
+}
+
+static void waitFor(sem_t *sem)
+{
+    while (sem_wait(sem) != 0 && errno == EINTR);
+}
+
+void ProcessPool::zygoteMain()
+{
+    zygoteWake = &control->wake;
+    struct sigaction action = {};
+    action.sa_handler = onChildExit;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+
+    pid_t zygotePid = getpid();
+    while (!control->stop)
+    {
+        for (auto &w : workers)
+        {
+            if (!w.shared) continue;
+            int request = w.shared->spawnRequest.load(std::memory_order_acquire);
+            if (request == w.shared->spawned.load(std::memory_order_relaxed)) continue;
+
+            w.shared->exited = 0;
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                signal(SIGCHLD, SIG_DFL);
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                if (getppid() != zygotePid) _exit(0);
+                workerMain(w.shared);
+                _exit(0);
+            }
+            w.shared->pid = pid;
+            if (pid < 0) w.shared->exited = 1;
+            w.shared->spawned.store(request, std::memory_order_release);
+        }
+        pid_t pid;
+        while ((pid = waitpid(-1, NULL, WNOHANG)) > 0)
+            for (auto &w : workers) if (w.shared && w.shared->pid == pid) w.shared->exited.store(1, std::memory_order_release);
+
+        // sleep until the host wants a worker, or one exited:
+        waitFor(&control->wake);
+    }
+    for (auto &w : workers) if (w.shared && !w.shared->exited && w.shared->pid > 0) kill(w.shared->pid, SIGKILL);
+    while (waitpid(-1, NULL, 0) > 0);
+}
+
+void ProcessPool::workerMain(Shared *shared)
+{
+    std::atomic<bool> cancel {false};
+    std::mutex jobMutex; // so `cancel` is never set for a job that already finished
+    int64_t runningJob = -1;
+
+    // Heartbeats come from their own thread, so a long job doesn't look like a hang. Hanging jobs are caught by
+    // jobTimeout. The same thread passes cancelUpTo() on to the running job.
+    std::thread watcher([&]() {
+        while (!shared->stop)
+        {
+            shared->heartbeat = nowNs();
+            bool running;
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                running = runningJob >= 0;
+                if (running && runningJob <= shared->cancelUpTo) cancel = true;
+            }
+            std::this_thread::sleep_for(running ? std::chrono::milliseconds(1) : std::chrono::milliseconds(100));
+        }
+    });
+    MessageHeader h;
+    std::vector<char> input, output;
+    while (!shared->stop)
+    {
+        if (!ringRead(shared->jobs, h, input))
+        {
+            waitFor(&shared->jobsAvailable); // until submit() or the destructor posts
+            continue;
+        }
+        output.clear();
+        bool success = false;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            runningJob = h.job;
+            cancel = false;
+        }
+        if (h.job > shared->cancelUpTo) // otherwise cancelled before it started
+        {
+            shared->jobStarted = nowNs();
+            try
+            {
+                success = handler(input, output, cancel);
+            }
+            catch (...)
+            {
+                success = false;
+            }
+            shared->jobStarted = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            runningJob = -1;
+        }
+
+        MessageHeader result = {h.job, uint32_t(output.size()), success};
+        if (sizeof(MessageHeader) + output.size() > shared->results->capacity)
+        {
+            result.size = 0;
+            result.success = false;
+        }
+        while (!shared->stop && !ringWrite(shared->results, result, output.data()))
+            std::this_thread::sleep_for(std::chrono::microseconds(200)); // only when the host doesn't poll()
+    }
+    watcher.join();
+}
+
+void ProcessPool::start(Worker &w)
+{
+    w.shared->stop = 0;
+    w.shared->heartbeat = nowNs();
+    w.shared->jobStarted = 0;
+    w.shared->jobs->head = w.shared->jobs->tail = 0;
+    w.shared->results->head = w.shared->results->tail = 0;
+    // no process uses the semaphore now, start counting from 0 again:
+    sem_destroy(&w.shared->jobsAvailable);
+    sem_init(&w.shared->jobsAvailable, 1, 0);
+
+    // send the jobs that didn't get a result again, they fitted in the ring before so they fit now:
+    for (auto &p : w.pending)
+        if (ringWrite(w.shared->jobs, {p.job, uint32_t(p.input.size()), 0}, p.input.data()))
+            sem_post(&w.shared->jobsAvailable);
+
+    w.state = Worker::STARTING;
+    w.pid = -1;
+    w.shared->spawnRequest.fetch_add(1, std::memory_order_release);
+    sem_post(&control->wake);
+}
+
+void ProcessPool::collectResults(Worker &w)
+{
+    MessageHeader h;
+    std::vector<char> output;
+    while (ringRead(w.shared->results, h, output))
+    {
+        // results come back in the order the jobs were sent:
+        if (!w.pending.empty() && w.pending.front().job == h.job) w.pending.pop_front();
+        results.push_back({h.job, h.success != 0, output});
+    }
+}
+
+void ProcessPool::failAll(Worker &w)
+{
+    for (auto &p : w.pending) results.push_back({p.job, false, {}});
+    w.pending.clear();
+}
+
+int64_t ProcessPool::submit(const std::vector<char> &input)
+{
+    if (zygote <= 0 || sizeof(MessageHeader) + input.size() > ringSize) return -1;
+
+    // try the least busy worker first, not the ones that are being killed:
+    std::vector<Worker *> order;
+    for (auto &w : workers) if (w.shared && w.state != Worker::STOPPING) order.push_back(&w);
+    std::sort(order.begin(), order.end(), [](Worker *a, Worker *b) { return a->pending.size() < b->pending.size(); });
+
+    for (Worker *w : order)
+    {
+        if (!ringWrite(w->shared->jobs, {nextJob, uint32_t(input.size()), 0}, input.data())) continue;
+        sem_post(&w->shared->jobsAvailable);
+        w->pending.push_back({nextJob, input});
+        return nextJob++;
+    }
+    return -1;
+}
+
+void ProcessPool::cancelUpTo(int64_t job)
+{
+    for (auto &w : workers) if (w.shared && job > w.shared->cancelUpTo) w.shared->cancelUpTo = job;
+}
+
+void ProcessPool::poll()
+{
+    if (zygote <= 0) return;
+    if (waitpid(zygote, NULL, WNOHANG) == zygote)
+    {
+        std::cout << "ProcessPool: the zygote died, no more jobs can be run.\n";
+        zygote = -1; // its workers got SIGKILL when it died
+        for (auto &w : workers) if (w.shared)
+        {
+            collectResults(w);
+            failAll(w);
+        }
+        return;
+    }
+    int64_t now = nowNs();
+    for (auto &w : workers)
+    {
+        if (!w.shared) continue;
+        collectResults(w);
+
+        if (w.state == Worker::STARTING)
+        {
+            if (w.shared->spawned.load(std::memory_order_acquire) != w.shared->spawnRequest.load(std::memory_order_relaxed))
+                continue; // the zygote didn't get to it yet
+            w.pid = w.shared->pid;
+            w.state = Worker::RUNNING;
+        }
+        bool exited = w.shared->exited.load(std::memory_order_acquire);
+        if (w.state == Worker::RUNNING && !exited)
+        {
+            int64_t jobStarted = w.shared->jobStarted;
+            bool hanging = now - w.shared->heartbeat > int64_t(heartbeatTimeout * 1e9);
+            bool overtime = jobTimeout > 0 && jobStarted > 0 && now - jobStarted > int64_t(jobTimeout * 1e9);
+            if (hanging || overtime)
+            {
+                kill(w.pid, SIGKILL);
+                w.state = Worker::STOPPING; // restarted once the zygote has reaped it
+            }
+        }
+        if (!exited) continue;
+
+        collectResults(w); // it might have written results just before dying.
+        nrOfRestarts++;
+        // the job it was working on is probably the reason it died:
+        if (!w.pending.empty())
+        {
+            results.push_back({w.pending.front().job, false, {}});
+            w.pending.pop_front();
+        }
+        start(w);
+    }
+}
+
+bool ProcessPool::popResult(Result &out)
+{
+    if (results.empty()) return false;
+    out = std::move(results.front());
+    results.pop_front();
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <sys/types.h>
+
+/**
+ * Pool of local worker processes, so that a crashing or hanging job doesn't take the editor down (Linux only).
+ *
+ * The constructor forks a zygote process, and workers are forked from the zygote, never from the host.
+ * Forking a process that has threads leaves locks (malloc etc.) in an undefined state in the child, so create the
+ * pool before starting any threads (ThreadPool, AsyncEvaluator...), but after setting up what the handler needs
+ * (node types, evaluation callbacks). If the host already has threads, no zygote is started and isValid() is false.
+ *
+ * Jobs and results travel through a pair of single-producer/single-consumer ring buffers in shared memory per worker,
+ * no sockets or pipes.
+ *
+ * Idle workers and the zygote block on process-shared semaphores, they don't poll.
+ *
+ * Every worker has a thread that sends heartbeats, independent of the job that is running. Workers that crash,
+ * stop sending heartbeats for `heartbeatTimeout` seconds (e.g. stopped or deadlocked), or run a single job for longer
+ * than `jobTimeout`, are killed and restarted by poll(). The job they were working on fails, jobs queued after it are
+ * sent again.
+ */
+class ProcessPool
+{
+  public:
+    // Runs in a worker process. Returns false if the job failed. Long jobs should stop when `cancel` becomes true.
+    typedef std::function<bool(const std::vector<char> &input, std::vector<char> &output,
+                               const std::atomic<bool> &cancel)> Handler;
+
+    struct Result
+    {
+        int64_t job;
+        bool success; // false if the handler failed or the worker crashed/timed out while running it
+        std::vector<char> output;
+    };
+
+    // ringSize: bytes per ring buffer, a job or result has to fit in one.
+    ProcessPool(int nrOfWorkers, Handler handler, size_t ringSize = 4 << 20);
+    ~ProcessPool();
+
+    // false if the zygote could not be started (see above) or died, no jobs can be run then.
+    bool isValid() const { return zygote > 0; }
+
+    // Sends a job to the worker with the fewest jobs queued. Returns the job id, or -1 if no worker had room for it.
+    int64_t submit(const std::vector<char> &input);
+
+    // Cancels the job with this id and all jobs submitted before it. A job that is running sees it through the
+    // `cancel` flag of the handler (within a millisecond), one that didn't start yet is skipped and fails.
+    // Either way they still get a Result.
+    void cancelUpTo(int64_t job);
+
+    // Call regularly (e.g. every frame). Collects results and restarts dead or hanging workers. Never blocks.
+    void poll();
+
+    // Returns false if there are no results collected by poll() left.
+    bool popResult(Result &out);
+
+    double heartbeatTimeout = 5;
+    double jobTimeout = 0; // seconds a single job may run, 0 = no limit
+
+    int getNrOfRestarts() const { return nrOfRestarts; }
+    int getNrOfWorkers() const { return workers.size(); }
+
+  private:
+    struct Shared;
+    struct Control;
+    struct Pending
+    {
+        int64_t job;
+        std::vector<char> input;
+    };
+    struct Worker
+    {
+        Shared *shared = NULL;
+        enum { STARTING, RUNNING, STOPPING } state = STARTING;
+        pid_t pid = -1;
+        std::deque<Pending> pending; // sent to this worker, in order, no result yet
+    };
+
+    Handler handler;
+    size_t ringSize;
+    std::vector<Worker> workers;
+    std::deque<Result> results;
+    int64_t nextJob = 0;
+    int nrOfRestarts = 0;
+
+    Control *control = NULL;
+    pid_t zygote = -1;
+
+    size_t mappingSize() const; // per worker
+    void start(Worker &w); // the old worker process must be gone
+    void collectResults(Worker &w);
+    void failAll(Worker &w);
+    void zygoteMain();
+    void workerMain(Shared *shared);
+};
+
+#endif
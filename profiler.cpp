@@ -0,0 +1,108 @@
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "profiler.h"
+
+EvaluationProfiler::EvaluationProfiler(size_t capacity) : slots(new Slot[capacity]), capacity(capacity)
+{}
+
+int64_t EvaluationProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EvaluationProfiler::record(const Node_ *node, int64_t startNs, int64_t durationNs, uint64_t bytesProduced)
+{
+    static thread_local uint32_t thread = uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    uint64_t i = nextEvent.fetch_add(1, std::memory_order_relaxed);
+    Slot &s = slots[i % capacity];
+    s.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.node.store(node, std::memory_order_relaxed);
+    s.type.store(node->type.get(), std::memory_order_relaxed);
+    s.startNs.store(startNs, std::memory_order_relaxed);
+    s.durationNs.store(durationNs, std::memory_order_relaxed);
+    s.bytesProduced.store(bytesProduced, std::memory_order_relaxed);
+    s.thread.store(thread, std::memory_order_relaxed);
+    s.stamp.store(i + 1, std::memory_order_release);
+
+    // nrOfEvents only counts events that are completely written, in order:
+    uint64_t expected = i;
+    while (!nrOfEvents.compare_exchange_weak(expected, i + 1, std::memory_order_release))
+    {
+        if (expected > i) break;
+        expected = i;
+        std::this_thread::yield(); // another thread is still writing an earlier event
+    }
+}
+
+bool EvaluationProfiler::read(uint64_t i, Event &out) const
+{
+    const Slot &s = slots[i % capacity];
+    if (s.stamp.load(std::memory_order_acquire) != i + 1) return false;
+    out.node = s.node.load(std::memory_order_relaxed);
+    out.type = s.type.load(std::memory_order_relaxed);
+    out.startNs = s.startNs.load(std::memory_order_relaxed);
+    out.durationNs = s.durationNs.load(std::memory_order_relaxed);
+    out.bytesProduced = s.bytesProduced.load(std::memory_order_relaxed);
+    out.thread = s.thread.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s.stamp.load(std::memory_order_relaxed) == i + 1; // not overwritten while copying
+}
+
+json EvaluationProfiler::toChromeTrace() const
+{
+    json events = json::array();
+    uint64_t end = getNrOfEvents(), begin = end > capacity ? end - capacity : 0;
+    Event e;
+    for (uint64_t i = begin; i < end; i++)
+    {
+        if (!read(i, e)) continue;
+        json ej;
+        ej["name"] = e.type->name;
+        ej["cat"] = "node";
+        ej["ph"] = "X"; // complete event
+        ej["ts"] = e.startNs / 1000.; // microseconds
+        ej["dur"] = e.durationNs / 1000.;
+        ej["pid"] = 0;
+        ej["tid"] = e.thread;
+        ej["args"]["node"] = uintptr_t(e.node);
+        ej["args"]["bytes"] = e.bytesProduced;
+        events.push_back(ej);
+    }
+    json trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+    return trace;
+}
+
+void ProfileSummary::collect(const EvaluationProfiler &profiler)
+{
+    uint64_t end = profiler.getNrOfEvents();
+    EvaluationProfiler::Event e;
+    for (; collected < end; collected++)
+    {
+        if (!profiler.read(collected, e)) continue; // overwritten before it was collected
+        if (e.startNs < since) continue;
+        NodeStats &s = stats[e.node];
+        s.totalNs += e.durationNs;
+        s.calls++;
+        s.bytesProduced += e.bytesProduced;
+        totalNs += e.durationNs;
+    }
+}
+
+const ProfileSummary::NodeStats *ProfileSummary::get(const Node_ *node) const
+{
+    auto s = stats.find(node);
+    return s == stats.end() ? NULL : &s->second;
+}
+
+void ProfileSummary::clear()
+{
+    stats.clear();
+    totalNs = 0;
+    since = EvaluationProfiler::now();
+}
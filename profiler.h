@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "node.h"
+
+/**
+ * Ring buffer of node evaluations (which node, when, how long, how many bytes it produced), filled by GraphEvaluator.
+ *
+ * Recording can be done by several evaluator threads without a mutex, reading can happen at the same time and never
+ * waits. It is not lock-free though: nrOfEvents only counts complete events in order, so a writer yields until the
+ * writers of earlier events have finished their few stores. When the buffer is full the oldest events are overwritten.
+ */
+class EvaluationProfiler
+{
+  public:
+    explicit EvaluationProfiler(size_t capacity = 1 << 16);
+
+    struct Event
+    {
+        const Node_ *node;
+        const NodeType_ *type;
+        int64_t startNs, durationNs;
+        uint64_t bytesProduced;
+        uint32_t thread;
+    };
+
+    void record(const Node_ *node, int64_t startNs, int64_t durationNs, uint64_t bytesProduced);
+
+    // Copies event number i (counting from the first one ever recorded) to `out`.
+    // Returns false if it was overwritten already, or is being written right now.
+    bool read(uint64_t i, Event &out) const;
+
+    // number of events recorded since creation
+    uint64_t getNrOfEvents() const { return nrOfEvents.load(std::memory_order_acquire); }
+
+    // The events that are still in the buffer, in Chrome's trace event format (chrome://tracing, Perfetto).
+    json toChromeTrace() const;
+
+    static int64_t now(); // nanoseconds, steady clock
+
+  private:
+    struct Slot
+    {
+        std::atomic<uint64_t> stamp {0}; // event index + 1 when complete, 0 while being written
+        std::atomic<const Node_ *> node {NULL};
+        std::atomic<const NodeType_ *> type {NULL};
+        std::atomic<int64_t> startNs {0}, durationNs {0};
+        std::atomic<uint64_t> bytesProduced {0};
+        std::atomic<uint32_t> thread {0};
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity;
+    std::atomic<uint64_t> nextEvent {0}, nrOfEvents {0};
+};
+
+typedef std::shared_ptr<EvaluationProfiler> EvaluationProfilerPtr;
+
+/**
+ * Per node totals of the events in a profiler, updated incrementally by collect().
+ */
+class ProfileSummary
+{
+  public:
+    struct NodeStats
+    {
+        int64_t totalNs = 0;
+        int calls = 0;
+        uint64_t bytesProduced = 0;
+    };
+
+    // adds the events that were recorded since the last collect().
+    void collect(const EvaluationProfiler &profiler);
+
+    const NodeStats *get(const Node_ *node) const;
+
+    int64_t getTotalNs() const { return totalNs; }
+
+    // Forgets all totals, and skips events that started before now, e.g. from an evaluation that is being cancelled.
+    // Call when a new evaluation starts, the nodes (the keys) of older ones might not exist anymore.
+    void clear();
+
+  private:
+    std::unordered_map<const Node_ *, NodeStats> stats;
+    int64_t totalNs = 0, since = 0;
+    uint64_t collected = 0;
+};
+
+#endif
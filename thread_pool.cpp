@@ -0,0 +1,70 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int nrOfWorkers) : nextChunk(0)
+{
+    for (int i = 0; i < nrOfWorkers; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers) t.join();
+}
+
+void ThreadPool::run(size_t count, Job newJob, const void *ctx)
+{
+    if (count == 0) return;
+    if (workers.empty())
+    {
+        newJob(ctx, 0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = newJob;
+        jobCtx = ctx;
+        jobSize = count;
+        // a few chunks per thread, so that a thread that gets expensive items doesn't hold up the rest:
+        chunkSize = count / (size() * 4);
+        if (chunkSize < 16) chunkSize = 16;
+        nextChunk = 0;
+        busyWorkers = int(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+    doChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return busyWorkers == 0; });
+    job = NULL;
+}
+
+void ThreadPool::doChunks()
+{
+    for (size_t begin; (begin = nextChunk.fetch_add(chunkSize)) < jobSize;)
+        job(jobCtx, begin, begin + chunkSize < jobSize ? begin + chunkSize : jobSize);
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+        }
+        doChunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) done.notify_one();
+        }
+    }
+}
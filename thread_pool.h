@@ -0,0 +1,53 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small pool of worker threads for data-parallel loops.
+ * parallelFor() does not allocate, so it can be used every frame.
+ */
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(int nrOfWorkers);
+    ~ThreadPool();
+
+    // number of threads that work on a parallelFor(), including the calling thread.
+    int size() const { return int(workers.size()) + 1; }
+
+    // Splits [0, count) into chunks and calls fn(begin, end) for each chunk, on the workers and on the calling thread.
+    // Returns when all chunks are done.
+    template <class Fn>
+    void parallelFor(size_t count, const Fn &fn)
+    {
+        run(count, [](const void *ctx, size_t begin, size_t end) {
+            (*static_cast<const Fn *>(ctx))(begin, end);
+        }, &fn);
+    }
+
+  private:
+    typedef void (*Job)(const void *ctx, size_t begin, size_t end);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    Job job = NULL;
+    const void *jobCtx = NULL;
+    size_t jobSize = 0, chunkSize = 1;
+    std::atomic<size_t> nextChunk;
+    int busyWorkers = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+
+    void run(size_t count, Job job, const void *ctx);
+    void doChunks();
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "value.h"
+
+struct Buffer::Block
+{
+    std::atomic<int> references;
+    size_t size, capacity;
+    int sizeClass; // -1 if not pooled
+    BufferPool *pool;
+
+    // the data follows the block header, aligned to 64 bytes
+    char *data() { return reinterpret_cast<char *>(this) + HEADER_SIZE; }
+
+    static const size_t HEADER_SIZE = 64;
+};
+
+Buffer::Buffer(const Buffer &other) : block(other.block)
+{
+    if (block) block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+Buffer::Buffer(Buffer &&other) noexcept : block(other.block)
+{
+    other.block = NULL;
+}
+
+Buffer &Buffer::operator=(Buffer other) noexcept
+{
+    std::swap(block, other.block);
+    return *this;
+}
+
+Buffer::~Buffer()
+{
+    if (block && block->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        block->pool->release(block);
+}
+
+const void *Buffer::data() const
+{
+    return block ? block->data() : NULL;
+}
+
+size_t Buffer::size() const
+{
+    return block ? block->size : 0;
+}
+
+bool Buffer::unique() const
+{
+    return block && block->references.load(std::memory_order_acquire) == 1;
+}
+
+void *Buffer::mutableData()
+{
+    if (!block) return NULL;
+    if (!unique())
+    {
+        Buffer copy = block->pool->allocate(block->size);
+        memcpy(copy.block->data(), block->data(), block->size);
+        *this = std::move(copy);
+    }
+    return block->data();
+}
+
+static int sizeClassOf(size_t size)
+{
+    int c = 0;
+    while ((size_t(1) << c) < size) c++;
+    return c;
+}
+
+Buffer BufferPool::allocate(size_t size)
+{
+    int sizeClass = sizeClassOf(size);
+    if (sizeClass < MIN_CLASS) sizeClass = MIN_CLASS;
+    if (sizeClass > MAX_CLASS) sizeClass = -1;
+    size_t capacity = sizeClass >= 0 ? size_t(1) << sizeClass : size;
+
+    Buffer::Block *block = NULL;
+    if (sizeClass >= 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &freeList = freeLists[sizeClass];
+        if (!freeList.empty())
+        {
+            block = freeList.back();
+            freeList.pop_back();
+        }
+    }
+    if (!block)
+    {
+        // aligned_alloc() wants a multiple of the alignment:
+        size_t bytes = (Buffer::Block::HEADER_SIZE + capacity + 63) & ~size_t(63);
+        void *mem = aligned_alloc(Buffer::Block::HEADER_SIZE, bytes);
+        if (!mem) throw std::bad_alloc();
+        block = new (mem) Buffer::Block;
+        block->capacity = capacity;
+        block->sizeClass = sizeClass;
+        block->pool = this;
+        bytesReserved += capacity;
+    }
+    block->references = 1;
+    block->size = size;
+    bytesInUse += capacity;
+    return Buffer(block);
+}
+
+void BufferPool::release(Buffer::Block *block)
+{
+    bytesInUse -= block->capacity;
+    if (block->sizeClass >= 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeLists[block->sizeClass].push_back(block);
+        return;
+    }
+    bytesReserved -= block->capacity;
+    block->~Block();
+    free(block);
+}
+
+void BufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &freeList : freeLists)
+    {
+        for (Buffer::Block *block : freeList)
+        {
+            bytesReserved -= block->capacity;
+            block->~Block();
+            free(block);
+        }
+        freeList.clear();
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
@@ -0,0 +1,105 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class BufferPool;
+
+/**
+ * Reference counted handle to a block of memory from a BufferPool.
+ *
+ * Copying a Buffer only increases the reference count, so a large output that goes to many inputs is never copied.
+ * Buffers are immutable once shared: mutableData() copies the data first if someone else also holds it (copy on write).
+ */
+class Buffer
+{
+  public:
+    Buffer() = default;
+    Buffer(const Buffer &other);
+    Buffer(Buffer &&other) noexcept;
+    Buffer &operator=(Buffer other) noexcept;
+    ~Buffer();
+
+    const void *data() const;
+    size_t size() const;
+
+    // Returns writable data, copies the buffer first if it is shared.
+    void *mutableData();
+
+    bool unique() const;
+    explicit operator bool() const { return block != NULL; }
+
+    template <class T> const T *as() const { return static_cast<const T *>(data()); }
+    template <class T> size_t count() const { return size() / sizeof(T); }
+
+  private:
+    friend class BufferPool;
+    struct Block;
+    Block *block = NULL;
+
+    explicit Buffer(Block *block) : block(block) {}
+};
+
+/**
+ * Allocates Buffers from free lists with power of two size classes.
+ * Released buffers go back to their free list, so the next evaluation run reuses them instead of going to the heap.
+ * Buffers keep a pointer to their pool, so the pool has to outlive them. Thread safe.
+ */
+class BufferPool
+{
+  public:
+    BufferPool() = default;
+    BufferPool(const BufferPool &) = delete;
+    ~BufferPool();
+
+    Buffer allocate(size_t size);
+
+    // frees all memory in the free lists.
+    void trim();
+
+    size_t getBytesReserved() const { return bytesReserved; } // in use + in free lists
+    size_t getBytesInUse() const { return bytesInUse; }
+
+  private:
+    friend class Buffer;
+    static const int MIN_CLASS = 6, MAX_CLASS = 30; // 64 bytes .. 1 GB, bigger buffers are not pooled.
+
+    std::mutex mutex;
+    std::vector<Buffer::Block *> freeLists[MAX_CLASS + 1];
+    std::atomic<size_t> bytesReserved {0}, bytesInUse {0};
+
+    void release(Buffer::Block *block);
+};
+
+/**
+ * A value flowing from an output connector to input connectors during evaluation.
+ * Numbers are stored inline, everything else (meshes, images, sample arrays) in a shared, immutable Buffer.
+ */
+struct Value
+{
+    double number = 0;
+    Buffer buffer;
+
+    static Value of(double number)
+    {
+        Value v;
+        v.number = number;
+        return v;
+    }
+
+    static Value of(Buffer buffer)
+    {
+        Value v;
+        v.buffer = std::move(buffer);
+        return v;
+    }
+
+    // bytes produced for this value
+    size_t size() const { return buffer ? buffer.size() : sizeof(number); }
+};
+
+#endif